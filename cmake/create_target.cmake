@@ -14,7 +14,10 @@ function(create_target TARGET_NAME)
 
 	target_include_directories(${TARGET_NAME} PUBLIC "${CMAKE_SOURCE_DIR}/lib/spdlog/include")
 
-	target_link_libraries(${TARGET_NAME} d3d12.lib d3dcompiler.lib dxgi.lib dxcompiler.lib)
+	target_link_libraries(${TARGET_NAME} d3d12.lib d3dcompiler.lib dxgi.lib dxcompiler.lib delayimp.lib)
+
+	# only load the compiler when shaders are compiled at runtime
+	target_link_options(${TARGET_NAME} PRIVATE "/DELAYLOAD:dxcompiler.dll")
 
 	if (CMAKE_VERSION VERSION_GREATER 3.12)
 	  set_property(TARGET ${TARGET_NAME} PROPERTY CXX_STANDARD 20)
@@ -0,0 +1,67 @@
+
+# Compiles a shader permutation at build time and embeds the DXIL in a generated header <NAME>.hpp
+# The header also holds the compile parameters, and the thread group size, bindings and root parameters
+# read back from the compiled shader by the embed_shader tool
+#
+# precompile_shader(<target> NAME <name> FILE <file in Shaders/> [ENTRY <entry>] [PROFILE <profile>] [DEFINES <KEY=VALUE>...])
+function(precompile_shader TARGET_NAME)
+
+	cmake_parse_arguments(SHADER "" "NAME;FILE;ENTRY;PROFILE" "DEFINES" ${ARGN})
+
+	if (NOT SHADER_ENTRY)
+		set(SHADER_ENTRY "main")
+	endif()
+
+	if (NOT SHADER_PROFILE)
+		set(SHADER_PROFILE "cs_6_7")
+	endif()
+
+	find_program(DXC_EXECUTABLE dxc HINTS "${D3D12BinPath}")
+	if (NOT DXC_EXECUTABLE)
+		message(FATAL_ERROR "dxc not found, run CMake from a developer prompt with the Windows SDK")
+	endif()
+
+	set(GENERATED_DIR "${CMAKE_CURRENT_BINARY_DIR}/generated")
+	set(SHADER_SOURCE "${CMAKE_CURRENT_SOURCE_DIR}/Shaders/${SHADER_FILE}")
+	set(SHADER_DXIL "${GENERATED_DIR}/${SHADER_NAME}.dxil")
+	set(SHADER_REFLECTION "${GENERATED_DIR}/${SHADER_NAME}.ref")
+	set(SHADER_HEADER "${GENERATED_DIR}/${SHADER_NAME}.hpp")
+
+	set(DEFINE_ARGUMENTS "")
+	foreach(DEFINE ${SHADER_DEFINES})
+		list(APPEND DEFINE_ARGUMENTS "-D" "${DEFINE}")
+	endforeach()
+
+	# includes are not tracked by dxc, so any change in Shaders recompiles
+	file(GLOB_RECURSE SHADER_DEPENDENCIES "${CMAKE_CURRENT_SOURCE_DIR}/Shaders/*")
+
+	add_custom_command(
+		OUTPUT "${SHADER_HEADER}"
+		COMMAND ${CMAKE_COMMAND} -E make_directory "${GENERATED_DIR}"
+		COMMAND "${DXC_EXECUTABLE}"
+			-T ${SHADER_PROFILE}
+			-E ${SHADER_ENTRY}
+			-O3
+			-HV 2021
+			-I "${CMAKE_CURRENT_SOURCE_DIR}/Shaders"
+			${DEFINE_ARGUMENTS}
+			-Fo "${SHADER_DXIL}"
+			-Fre "${SHADER_REFLECTION}"
+			"${SHADER_SOURCE}"
+		COMMAND embed_shader
+			"${SHADER_DXIL}"
+			"${SHADER_REFLECTION}"
+			"${SHADER_HEADER}"
+			${SHADER_NAME}
+			${SHADER_FILE}
+			${SHADER_ENTRY}
+			${SHADER_PROFILE}
+			${SHADER_DEFINES}
+		DEPENDS ${SHADER_DEPENDENCIES} embed_shader
+		COMMENT "Precompiling ${SHADER_NAME} of ${TARGET_NAME}"
+		VERBATIM
+	)
+
+	target_sources(${TARGET_NAME} PRIVATE "${SHADER_HEADER}")
+	target_include_directories(${TARGET_NAME} PRIVATE "${GENERATED_DIR}")
+endfunction(precompile_shader TARGET_NAME)
@@ -0,0 +1,41 @@
+
+// Inputs:
+//	THREAD_GROUP_SIZE
+
+#if __RESHARPER__
+#define THREAD_GROUP_SIZE 64
+#endif
+
+// Keep in sync with BatchJob in dx12.hpp
+struct BatchJob
+{
+	uint inputOffset;
+	uint inputLength;
+	uint outputOffset;
+	uint outputLength;
+	uint groupOffset;
+	uint groupCount;
+};
+
+RWStructuredBuffer<BatchJob> jobTable : register(u0);
+RWStructuredBuffer<uint> groupJobs : register(u1);
+RWStructuredBuffer<float> inputArena : register(u2);
+RWStructuredBuffer<float> outputArena : register(u3);
+
+[RootSignature("RootFlags(0), UAV(u0), UAV(u1), UAV(u2), UAV(u3)")]
+[numthreads(THREAD_GROUP_SIZE, 1, 1)]
+void main(
+	uint3 inGroupID : SV_GroupID,
+	uint inGroupIndex : SV_GroupIndex)
+{
+	// look up the job of this thread group
+	uint jobIndex = groupJobs[inGroupID.x];
+	BatchJob job = jobTable[jobIndex];
+
+	// every job scales its own inputs, groups of the same job split the elements
+	uint localGroup = inGroupID.x - job.groupOffset;
+	for (uint i = localGroup * THREAD_GROUP_SIZE + inGroupIndex; i < job.outputLength; i += job.groupCount * THREAD_GROUP_SIZE)
+	{
+		outputArena[job.outputOffset + i] = inputArena[job.inputOffset + i] * (float)(jobIndex + 1);
+	}
+}
@@ -0,0 +1,55 @@
+#include "dx12.hpp"
+
+SETUP_DX12;
+
+int main()
+{
+	DX12Env dx12 = DX12Env::InitializeDX12();
+
+	const uint32_t threadGroupSize = 64;
+
+	const uint32_t jobCount = 1000;
+	const uint32_t maxJobLength = 32;
+
+	ShaderDefines defines;
+	defines.AddDefine(L"THREAD_GROUP_SIZE", threadGroupSize);
+
+	Shader shader = dx12.CompileShader(L"Shader.hlsl", L"main", defines);
+
+	// arenas shared by all jobs, a single job never needs more than one thread group here
+	JobBatch<float, float> batch = dx12.CreateJobBatch<float, float>(jobCount, jobCount, jobCount * maxJobLength, jobCount * maxJobLength);
+
+	std::vector<float> input(maxJobLength);
+	for (uint32_t job = 0; job < jobCount; job++)
+	{
+		uint32_t length = 1 + job % maxJobLength;
+		for (uint32_t i = 0; i < length; i++)
+		{
+			input[i] = (float)i;
+		}
+
+		batch.AddJob(input.data(), length, length);
+	}
+
+	// initialize shader
+	dx12.SetShader(shader);
+
+	// upload, dispatch and readback all jobs at once
+	dx12.DispatchJobBatch(batch);
+
+	// execute all commands
+	if (!dx12.FlushQueue())
+	{
+		return -1;
+	}
+
+	JobBatchResults<float, float> results = dx12.GetJobBatchResults(batch);
+
+	for (uint32_t job = 0; job < 4; job++)
+	{
+		JobView<float> output = results[job];
+		spdlog::info("job {0:d}: length {1:d}, last = {2:.3f}", job, output.length, output[output.length - 1]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include "dx12.hpp"
+#include "SimpleShader.hpp"
+
+SETUP_DX12;
+
+struct ConstantInput
+{
+	float divValue;
+};
+
+int main()
+{
+	// the shader is compiled at build time, so the compiler is never loaded
+	DX12Env dx12 = DX12Env::InitializeDX12(false);
+
+	// the thread group size is reflected from the shader, the dispatch size is one of the defines in CMakeLists.txt
+	const uint32_t* threadGroupSize = SimpleShader.threadGroupSize;
+	const uint32_t dispatchSizeX = std::stoul(SimpleShader.FindDefine("DISPATCH_SIZE_X"));
+	const uint32_t dispatchSizeY = std::stoul(SimpleShader.FindDefine("DISPATCH_SIZE_Y"));
+	const uint32_t dispatchSizeZ = std::stoul(SimpleShader.FindDefine("DISPATCH_SIZE_Z"));
+	const uint32_t totalSize = threadGroupSize[0] * threadGroupSize[1] * threadGroupSize[2] * dispatchSizeX * dispatchSizeY * dispatchSizeZ;
+
+	// root parameters of the bindings, from the root signature of the shader
+	const uint32_t constantParameter = SimpleShader.FindRootParameter(*SimpleShader.FindBinding("ConstantInput"));
+	const uint32_t uavParameter = SimpleShader.FindRootParameter(*SimpleShader.FindBinding("uav"));
+
+	Shader shader = dx12.LoadPrecompiledShader(SimpleShader);
+
+	Buffer<ConstantInput> constantBuffer = dx12.CreateBuffer<ConstantInput>(1, GPUConstant | CPUWrite);
+	Buffer<float> gpuBuffer = dx12.CreateBuffer<float>(totalSize * 4, CPURead | CPUWrite);
+
+	WriteView<float> gpuBufferView = dx12.GetWriteView(gpuBuffer);
+	for (int j = 0; j < totalSize; j++)
+	{
+		gpuBufferView[j * 4] = (float)j;
+		gpuBufferView[j * 4 + 1] = 0;
+		gpuBufferView[j * 4 + 2] = 0;
+		gpuBufferView[j * 4 + 3] = 0;
+	}
+	gpuBufferView.Close();
+
+	WriteView<ConstantInput> constantView = dx12.GetWriteView(constantBuffer);
+	constantView[0].divValue = 5.0f;
+	constantView.Close();
+
+	// initialize shader
+	dx12.SetShader(shader);
+
+	// upload buffers
+	dx12.UploadBuffer(gpuBuffer);
+	dx12.UploadBuffer(constantBuffer);
+
+	// set buffer inputs
+	dx12.SetBuffer(constantParameter, constantBuffer);
+	dx12.SetBuffer(uavParameter, gpuBuffer);
+
+	// dispatch the shader
+	dx12.DispatchShader(dispatchSizeX, dispatchSizeY, dispatchSizeZ);
+
+	// add readback
+	dx12.ReadbackBuffer(gpuBuffer);
+
+	// execute all commands
+	if (!dx12.FlushQueue())
+	{
+		return -1;
+	}
+
+	ReadView<float> outputView = dx12.GetReadView(gpuBuffer);
+
+	for (int x = 0; x < 2; x++)
+	{
+		spdlog::info("uav[{0:d}] = {1:.3f}, {2:.3f}, {3:.3f}, {4:.3f}", x, outputView[x * 4 + 0], outputView[x * 4 + 1], outputView[x * 4 + 2], outputView[x * 4 + 3]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,277 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Compiler for declarative compute graphs
+// Has no dependency on dx12, so the ordering, culling and aliasing can be tested without a device
+
+constexpr uint32_t GraphNone = UINT32_MAX;
+
+struct GraphResourceDesc
+{
+    std::string name;
+    uint64_t size;
+    uint64_t alignment;
+    bool imported;
+};
+
+struct GraphPassDesc
+{
+    std::string name;
+    std::vector<uint32_t> reads;
+    std::vector<uint32_t> writes;
+    bool sideEffects;
+};
+
+enum GraphBarrierType : uint32_t
+{
+    GraphUAVBarrier = 0,
+    GraphAliasingBarrier = 1
+};
+
+// Aliasing barriers don't name the resource before, as the memory may have been used by several resources,
+// including resources of an earlier execution of the same graph
+struct GraphBarrier
+{
+    GraphBarrierType type;
+    uint32_t resource;
+};
+
+// A pass that survived culling, together with the barriers that have to be recorded before it
+struct GraphStep
+{
+    uint32_t pass;
+    std::vector<GraphBarrier> barriers;
+};
+
+struct CompiledGraph
+{
+    std::vector<GraphStep> steps;
+    std::vector<bool> culled;           // per pass
+    std::vector<uint32_t> firstStep;    // per resource, GraphNone if the resource is never used
+    std::vector<uint32_t> lastStep;     // per resource, GraphNone if the resource is never used
+    std::vector<uint64_t> heapOffsets;  // per resource, only valid for used transient resources
+    uint64_t heapSize = 0;
+
+    bool IsUsed(uint32_t resource) const
+    {
+        return firstStep[resource] != GraphNone;
+    }
+};
+
+struct GraphBuilder
+{
+    std::vector<GraphResourceDesc> resources;
+    std::vector<GraphPassDesc> passes;
+
+    // imported resources live outside of the graph, they are never aliased and always count as consumed
+    // transient resources take up their size rounded up to their alignment in the heap
+    uint32_t AddResource(const std::string& name, uint64_t size, uint64_t alignment, bool imported)
+    {
+        resources.push_back({ name, size, alignment, imported });
+        return (uint32_t)resources.size() - 1;
+    }
+
+    // passes with side effects are never culled, even if nothing consumes their outputs
+    uint32_t AddPass(const std::string& name, const std::vector<uint32_t>& reads, const std::vector<uint32_t>& writes, bool sideEffects = false)
+    {
+        passes.push_back({ name, reads, writes, sideEffects });
+        return (uint32_t)passes.size() - 1;
+    }
+
+    CompiledGraph Compile() const
+    {
+        uint32_t resourceCount = (uint32_t)resources.size();
+        uint32_t passCount = (uint32_t)passes.size();
+
+        CompiledGraph compiled;
+        compiled.culled.assign(passCount, true);
+        compiled.firstStep.assign(resourceCount, GraphNone);
+        compiled.lastStep.assign(resourceCount, GraphNone);
+        compiled.heapOffsets.assign(resourceCount, 0);
+
+        // walk backwards, a pass is kept if it writes a resource that is consumed later on
+        std::vector<bool> consumed(resourceCount, false);
+        for (uint32_t r = 0; r < resourceCount; r++)
+        {
+            consumed[r] = resources[r].imported;
+        }
+
+        for (uint32_t p = passCount; p-- > 0;)
+        {
+            const GraphPassDesc& pass = passes[p];
+
+            bool keep = pass.sideEffects;
+            for (uint32_t r : pass.writes)
+            {
+                keep |= consumed[r];
+            }
+
+            if (!keep)
+            {
+                continue;
+            }
+
+            compiled.culled[p] = false;
+            for (uint32_t r : pass.reads)
+            {
+                consumed[r] = true;
+            }
+        }
+
+        // lifetimes in steps of the kept passes
+        for (uint32_t p = 0; p < passCount; p++)
+        {
+            if (compiled.culled[p])
+            {
+                continue;
+            }
+
+            uint32_t step = (uint32_t)compiled.steps.size();
+            compiled.steps.push_back({ p, {} });
+
+            for (const std::vector<uint32_t>* accesses : { &passes[p].reads, &passes[p].writes })
+            {
+                for (uint32_t r : *accesses)
+                {
+                    if (compiled.firstStep[r] == GraphNone)
+                    {
+                        compiled.firstStep[r] = step;
+                    }
+                    compiled.lastStep[r] = step;
+                }
+            }
+        }
+
+        PlaceTransients(compiled);
+        AddBarriers(compiled);
+
+        return compiled;
+    }
+
+private:
+    static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint64_t AllocationSize(uint32_t resource) const
+    {
+        return AlignUp(resources[resource].size, resources[resource].alignment);
+    }
+
+    bool LifetimesOverlap(const CompiledGraph& compiled, uint32_t a, uint32_t b) const
+    {
+        return compiled.firstStep[a] <= compiled.lastStep[b] && compiled.firstStep[b] <= compiled.lastStep[a];
+    }
+
+    bool MemoryOverlaps(const CompiledGraph& compiled, uint32_t a, uint32_t b) const
+    {
+        return compiled.heapOffsets[a] < compiled.heapOffsets[b] + AllocationSize(b) &&
+               compiled.heapOffsets[b] < compiled.heapOffsets[a] + AllocationSize(a);
+    }
+
+    // first fit of the largest resources first, resources that are alive at the same time never share memory
+    void PlaceTransients(CompiledGraph& compiled) const
+    {
+        std::vector<uint32_t> order;
+        for (uint32_t r = 0; r < (uint32_t)resources.size(); r++)
+        {
+            if (!resources[r].imported && compiled.IsUsed(r))
+            {
+                order.push_back(r);
+            }
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return AllocationSize(a) > AllocationSize(b); });
+
+        std::vector<uint32_t> placed;
+        for (uint32_t r : order)
+        {
+            std::vector<uint32_t> alive;
+            for (uint32_t other : placed)
+            {
+                if (LifetimesOverlap(compiled, r, other))
+                {
+                    alive.push_back(other);
+                }
+            }
+
+            std::sort(alive.begin(), alive.end(), [&](uint32_t a, uint32_t b) { return compiled.heapOffsets[a] < compiled.heapOffsets[b]; });
+
+            uint64_t offset = 0;
+            for (uint32_t other : alive)
+            {
+                if (offset + AllocationSize(r) <= compiled.heapOffsets[other])
+                {
+                    break;
+                }
+
+                offset = (std::max)(offset, AlignUp(compiled.heapOffsets[other] + AllocationSize(other), resources[r].alignment));
+            }
+
+            compiled.heapOffsets[r] = offset;
+            compiled.heapSize = (std::max)(compiled.heapSize, offset + AllocationSize(r));
+            placed.push_back(r);
+        }
+    }
+
+    // a UAV barrier is only needed when a write is followed by any access, or a read is followed by a write
+    // a transient resource that shares memory with any other resource gets an aliasing barrier on its first use instead,
+    // also when the other resource is only used later on, as it used the memory in the previous execution of the graph
+    void AddBarriers(CompiledGraph& compiled) const
+    {
+        uint32_t resourceCount = (uint32_t)resources.size();
+        std::vector<bool> pendingRead(resourceCount, false);
+        std::vector<bool> pendingWrite(resourceCount, false);
+
+        for (uint32_t step = 0; step < (uint32_t)compiled.steps.size(); step++)
+        {
+            GraphStep& graphStep = compiled.steps[step];
+            const GraphPassDesc& pass = passes[graphStep.pass];
+
+            std::vector<uint32_t> accessed = pass.reads;
+            accessed.insert(accessed.end(), pass.writes.begin(), pass.writes.end());
+            std::sort(accessed.begin(), accessed.end());
+            accessed.erase(std::unique(accessed.begin(), accessed.end()), accessed.end());
+
+            for (uint32_t r : accessed)
+            {
+                bool reads = std::find(pass.reads.begin(), pass.reads.end(), r) != pass.reads.end();
+                bool writes = std::find(pass.writes.begin(), pass.writes.end(), r) != pass.writes.end();
+
+                if (!resources[r].imported && compiled.firstStep[r] == step)
+                {
+                    if (SharesMemory(compiled, r))
+                    {
+                        graphStep.barriers.push_back({ GraphAliasingBarrier, r });
+                    }
+                }
+                else if (pendingWrite[r] || (writes && pendingRead[r]))
+                {
+                    graphStep.barriers.push_back({ GraphUAVBarrier, r });
+                    pendingRead[r] = false;
+                    pendingWrite[r] = false;
+                }
+
+                pendingRead[r] = pendingRead[r] || reads;
+                pendingWrite[r] = pendingWrite[r] || writes;
+            }
+        }
+    }
+
+    bool SharesMemory(const CompiledGraph& compiled, uint32_t resource) const
+    {
+        for (uint32_t r = 0; r < (uint32_t)resources.size(); r++)
+        {
+            if (r != resource && !resources[r].imported && compiled.IsUsed(r) && MemoryOverlaps(compiled, r, resource))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
@@ -1,14 +1,19 @@
 ﻿#pragma once
 #include <string>
+#include <cstring>
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include <dxcapi.h>
 #include <d3d12shader.h>
 #include <unordered_map>
+#include <vector>
+#include <algorithm>
 #include <filesystem>
+#include <functional>
 #include <wrl.h>
 #define SPDLOG_WCHAR_TO_UTF8_SUPPORT
 #include "spdlog/spdlog.h"
+#include "compute_graph.hpp"
 
 // DELETE
 #include <iostream>
@@ -21,6 +26,8 @@ using namespace Microsoft::WRL;
 struct DX12Env;
 struct Shader;
 struct ShaderCompilation;
+struct CommandContext;
+struct ComputeGraph;
 
 // Util to temporarily switch cwd to Shaders
 struct ShaderPathUtil
@@ -42,12 +49,14 @@ enum BufferFlags : uint32_t
 {
     CPURead = 1,
     CPUWrite = 2,
-    GPUConstant = 4
+    GPUConstant = 4,
+    Reserved = 8
 };
 
 BufferFlags operator|(BufferFlags x, BufferFlags y) { return (BufferFlags)((uint32_t)x | (uint32_t)y); }
 
 
+// state is the state the buffer is left in by the last submitted command list, only updated by DX12Env::FlushQueue
 struct DX12Buffer
 {
     ComPtr<ID3D12Resource> buffer;
@@ -60,15 +69,16 @@ struct Buffer
     DX12Buffer gpuBuffer;
     DX12Buffer hostUploadBuffer;
     DX12Buffer hostReadbackBuffer;
-    uint32_t length = 0;
+    uint64_t length = 0;
     BufferFlags flags = 0;
+    std::unordered_map<uint64_t, uint32_t> committedTiles; // only used by reserved buffers, tile in buffer -> tile in pool
 };
 
 template<typename T>
 struct ReadView
 {
     T* data;
-    uint32_t length;
+    uint64_t length;
     Buffer<T>* buffer;
 
     bool IsClosed()
@@ -93,7 +103,7 @@ struct ReadView
         Close();
     }
 
-    const T& operator[](uint32_t offset) const
+    const T& operator[](uint64_t offset) const
     {
         return data[offset];
     }
@@ -103,7 +113,7 @@ template<typename T>
 struct WriteView
 {
     T* data;
-    uint32_t length;
+    uint64_t length;
     Buffer<T>* buffer;
 
     bool IsClosed()
@@ -118,7 +128,7 @@ struct WriteView
             return;
         }
 
-        D3D12_RANGE range = { 0, buffer->length };
+        D3D12_RANGE range = { 0, (SIZE_T)(sizeof(T) * buffer->length) };
         buffer->hostUploadBuffer.buffer->Unmap(0, &range);
 
         data = nullptr;
@@ -129,17 +139,375 @@ struct WriteView
         Close();
     }
 
-    const T& operator[](uint32_t offset) const
+    const T& operator[](uint64_t offset) const
+    {
+        return data[offset];
+    }
+
+    T& operator[](uint64_t offset)
     {
         return data[offset];
     }
+};
+
+// Heaps that back the 64 KiB tiles of reserved buffers, decommitted tiles are reused before new heaps are created
+struct TilePool
+{
+    std::vector<ComPtr<ID3D12Heap>> heaps; // nullptr for heaps that were trimmed
+    std::vector<uint32_t> freeTiles;       // heap index * tilesPerHeap + tile in heap
+    uint32_t tilesPerHeap = 256;
+    uint32_t usedTiles = 0;
+};
+
+// Shader visible heap for the descriptors of textures, descriptors are never freed
+struct DescriptorHeap
+{
+    ComPtr<ID3D12DescriptorHeap> heap;
+    uint32_t descriptorSize = 0;
+    uint32_t capacity = 0;
+    uint32_t count = 0;
+
+    // returns UINT32_MAX if the heap is full
+    uint32_t Allocate()
+    {
+        if (count >= capacity)
+        {
+            return UINT32_MAX;
+        }
+
+        return count++;
+    }
+
+    D3D12_CPU_DESCRIPTOR_HANDLE GetCPUHandle(uint32_t index)
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE handle = heap->GetCPUDescriptorHandleForHeapStart();
+        handle.ptr += (SIZE_T)index * descriptorSize;
+        return handle;
+    }
+
+    D3D12_GPU_DESCRIPTOR_HANDLE GetGPUHandle(uint32_t index)
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE handle = heap->GetGPUDescriptorHandleForHeapStart();
+        handle.ptr += (UINT64)index * descriptorSize;
+        return handle;
+    }
+};
+
+// Default format of the texels of a texture, pass the format explicitly for other types
+template<typename T>
+struct TextureFormat;
+
+template<> struct TextureFormat<float> { static constexpr DXGI_FORMAT format = DXGI_FORMAT_R32_FLOAT; };
+template<> struct TextureFormat<uint32_t> { static constexpr DXGI_FORMAT format = DXGI_FORMAT_R32_UINT; };
+template<> struct TextureFormat<int32_t> { static constexpr DXGI_FORMAT format = DXGI_FORMAT_R32_SINT; };
+template<> struct TextureFormat<uint16_t> { static constexpr DXGI_FORMAT format = DXGI_FORMAT_R16_UINT; };
+template<> struct TextureFormat<uint8_t> { static constexpr DXGI_FORMAT format = DXGI_FORMAT_R8_UINT; };
+
+// Texture in the tiled layout of the GPU, which keeps 2D and 3D neighbourhoods close in memory
+// The host buffers are row major with the row pitch of the copyable footprint
+template<typename T, uint32_t Dimensions>
+struct Texture
+{
+    DX12Buffer gpuTexture;
+    DX12Buffer hostUploadBuffer;
+    DX12Buffer hostReadbackBuffer;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t depth = 0;
+    BufferFlags flags = (BufferFlags)0;
+    ID3D12DescriptorHeap* descriptorHeap = nullptr;
+    D3D12_GPU_DESCRIPTOR_HANDLE uavHandle = {};
+    D3D12_GPU_DESCRIPTOR_HANDLE srvHandle = {};
+};
+
+template<typename T>
+using Texture2D = Texture<T, 2>;
+
+template<typename T>
+using Texture3D = Texture<T, 3>;
+
+template<typename T>
+struct TextureReadView
+{
+    const uint8_t* data;
+    uint64_t rowPitch;
+    uint64_t slicePitch;
+    ID3D12Resource* resource;
+
+    bool IsClosed()
+    {
+        return data == nullptr;
+    }
+
+    void Close()
+    {
+        if (IsClosed())
+        {
+            return;
+        }
+
+        resource->Unmap(0, nullptr);
+
+        data = nullptr;
+    }
+
+    ~TextureReadView()
+    {
+        Close();
+    }
+
+    const T& operator()(uint32_t x, uint32_t y, uint32_t z = 0) const
+    {
+        return *reinterpret_cast<const T*>(data + z * slicePitch + y * rowPitch + x * sizeof(T));
+    }
+};
+
+template<typename T>
+struct TextureWriteView
+{
+    uint8_t* data;
+    uint64_t rowPitch;
+    uint64_t slicePitch;
+    ID3D12Resource* resource;
+
+    bool IsClosed()
+    {
+        return data == nullptr;
+    }
+
+    void Close()
+    {
+        if (IsClosed())
+        {
+            return;
+        }
+
+        resource->Unmap(0, nullptr);
+
+        data = nullptr;
+    }
+
+    ~TextureWriteView()
+    {
+        Close();
+    }
+
+    const T& operator()(uint32_t x, uint32_t y, uint32_t z = 0) const
+    {
+        return *reinterpret_cast<const T*>(data + z * slicePitch + y * rowPitch + x * sizeof(T));
+    }
+
+    T& operator()(uint32_t x, uint32_t y, uint32_t z = 0)
+    {
+        return *reinterpret_cast<T*>(data + z * slicePitch + y * rowPitch + x * sizeof(T));
+    }
+};
+
+// Entry of the offset table of a JobBatch, one per job
+// Mirrors the BatchJob struct in the shader, so keep the layout in sync
+struct BatchJob
+{
+    uint32_t inputOffset;
+    uint32_t inputLength;
+    uint32_t outputOffset;
+    uint32_t outputLength;
+    uint32_t groupOffset;
+    uint32_t groupCount;
+};
+
+// Gathers many small jobs for the same shader into shared arenas, so they can be executed with a single dispatch
+// Every thread group looks up its job through groupJobs and reads the offsets of its job from jobTable
+// The arenas are written on the CPU while recording, so a batch can only be dispatched once per flush:
+// after DispatchJobBatch the batch is in flight and can't be changed until GetJobBatchResults is called
+template<typename TIn, typename TOut>
+struct JobBatch
+{
+    Buffer<BatchJob> jobTable;
+    Buffer<uint32_t> groupJobs;
+    Buffer<TIn> inputArena;
+    Buffer<TOut> outputArena;
+
+    std::vector<BatchJob> jobs;
+    std::vector<TIn> inputs;
+    uint32_t outputLength = 0;
+    uint32_t groupCount = 0;
+    bool inFlight = false;
+
+    // sums in 64 bit, so large jobs can't wrap around and pass
+    bool CanFit(uint32_t jobInputLength, uint32_t jobOutputLength, uint32_t jobGroupCount) const
+    {
+        return jobs.size() < jobTable.length &&
+               (uint64_t)inputs.size() + jobInputLength <= inputArena.length &&
+               (uint64_t)outputLength + jobOutputLength <= outputArena.length &&
+               (uint64_t)groupCount + jobGroupCount <= groupJobs.length;
+    }
+
+    // returns the index of the job in the batch, or UINT32_MAX if the batch is full, in flight or the job has no groups
+    uint32_t AddJob(const TIn* input, uint32_t jobInputLength, uint32_t jobOutputLength, uint32_t jobGroupCount = 1)
+    {
+        if (inFlight || jobGroupCount == 0 || !CanFit(jobInputLength, jobOutputLength, jobGroupCount))
+        {
+            return UINT32_MAX;
+        }
+
+        BatchJob job = {
+            (uint32_t)inputs.size(),
+            jobInputLength,
+            outputLength,
+            jobOutputLength,
+            groupCount,
+            jobGroupCount
+        };
+
+        inputs.insert(inputs.end(), input, input + jobInputLength);
+        outputLength += jobOutputLength;
+        groupCount += jobGroupCount;
+
+        jobs.push_back(job);
+        return (uint32_t)jobs.size() - 1;
+    }
+
+    bool IsEmpty() const
+    {
+        return jobs.empty();
+    }
+
+    // returns false if the batch is in flight
+    bool Clear()
+    {
+        if (inFlight)
+        {
+            return false;
+        }
+
+        jobs.clear();
+        inputs.clear();
+        outputLength = 0;
+        groupCount = 0;
+        return true;
+    }
+};
 
-    T& operator[](uint32_t offset)
+// Output of a single job inside the readback of a JobBatch
+template<typename T>
+struct JobView
+{
+    const T* data;
+    uint32_t length;
+
+    const T& operator[](uint32_t offset) const
     {
         return data[offset];
     }
 };
 
+// Scatters the readback of a JobBatch back into per-job views
+// Keeps the output arena mapped until it goes out of scope
+template<typename TIn, typename TOut>
+struct JobBatchResults
+{
+    ReadView<TOut> outputView;
+    JobBatch<TIn, TOut>* batch;
+
+    JobView<TOut> operator[](uint32_t job) const
+    {
+        const BatchJob& entry = batch->jobs[job];
+        return { outputView.data + entry.outputOffset, entry.outputLength };
+    }
+};
+
+// Handle to a buffer inside a ComputeGraph
+struct GraphBuffer
+{
+    uint32_t index;
+};
+
+// Passed to the function of a pass to bind the buffers of the graph
+struct ComputeGraphResources
+{
+    ComputeGraph* graph;
+    CommandContext* context;
+
+    void SetBuffer(uint32_t index, GraphBuffer buffer);
+};
+
+using GraphPassFunction = std::function<void(CommandContext&, ComputeGraphResources&)>;
+
+// Declarative compute pipeline, every pass declares the buffers it reads and writes
+// Transient buffers are placed in a heap owned by the graph, which lives as long as the graph does
+// Transient buffers whose lifetimes within the graph don't overlap share memory in that heap
+// Imported buffers are regular buffers that are always kept alive, so passes writing to them are never culled
+struct ComputeGraph
+{
+    GraphBuilder builder;
+    std::vector<GraphPassFunction> passFunctions;
+    std::vector<DX12Buffer*> importedBuffers;
+
+    CompiledGraph compiled;
+    ComPtr<ID3D12Heap> heap;
+    std::vector<ComPtr<ID3D12Resource>> transientBuffers;
+
+    // false if the graph was never compiled, or buffers or passes were added after compiling it
+    bool IsCompiled() const
+    {
+        return compiled.firstStep.size() == builder.resources.size() && compiled.culled.size() == builder.passes.size();
+    }
+
+    template<typename T>
+    GraphBuffer CreateBuffer(const std::string& name, uint64_t length)
+    {
+        // placed buffers always take up whole 64 KiB blocks of the heap
+        const uint64_t alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        uint64_t size = (sizeof(T) * length + alignment - 1) / alignment * alignment;
+
+        importedBuffers.push_back(nullptr);
+        return { builder.AddResource(name, size, alignment, false) };
+    }
+
+    template<typename T>
+    GraphBuffer ImportBuffer(const std::string& name, Buffer<T>& buffer)
+    {
+        // all graph buffers are bound as unordered access, which constant buffers don't allow
+        if (buffer.flags & GPUConstant)
+        {
+            spdlog::error("Can't import constant buffer {} into a graph, bind it with SetBuffer in the pass instead", name);
+            exit(-1);
+        }
+
+        importedBuffers.push_back(&buffer.gpuBuffer);
+        return { builder.AddResource(name, sizeof(T) * buffer.length, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, true) };
+    }
+
+    void AddPass(const std::string& name, const std::vector<GraphBuffer>& reads, const std::vector<GraphBuffer>& writes, GraphPassFunction function, bool sideEffects = false)
+    {
+        std::vector<uint32_t> readIndices;
+        for (GraphBuffer buffer : reads)
+        {
+            readIndices.push_back(buffer.index);
+        }
+
+        std::vector<uint32_t> writeIndices;
+        for (GraphBuffer buffer : writes)
+        {
+            writeIndices.push_back(buffer.index);
+        }
+
+        builder.AddPass(name, readIndices, writeIndices, sideEffects);
+        passFunctions.push_back(function);
+    }
+
+    ID3D12Resource* GetResource(uint32_t index)
+    {
+        if (importedBuffers[index])
+        {
+            return importedBuffers[index]->buffer.Get();
+        }
+
+        return transientBuffers[index].Get();
+    }
+};
+
 // usually the device with the most video memory is the best card
 // change this if you want another device
 bool IsAdapterBetter(DXGI_ADAPTER_DESC1& prevAdapter, DXGI_ADAPTER_DESC1& newAdapter)
@@ -172,6 +540,219 @@ struct Shader
     ComPtr<ID3D12PipelineState> pso;
 };
 
+struct ShaderDefine
+{
+    const char* name;
+    const char* value;
+};
+
+// A resource the shader binds, from the reflection of the DXIL
+struct ShaderBinding
+{
+    const char* name;
+    D3D_SHADER_INPUT_TYPE type;
+    uint32_t bindPoint;
+    uint32_t space;
+    uint32_t bindCount;
+};
+
+// A parameter of the root signature of the shader
+// Descriptor tables are described by their first range, the registers [shaderRegister, shaderRegister + numDescriptors)
+struct ShaderRootParameter
+{
+    D3D12_ROOT_PARAMETER_TYPE type;
+    uint32_t shaderRegister;
+    uint32_t registerSpace;
+    uint32_t num32BitValues;
+    D3D12_DESCRIPTOR_RANGE_TYPE rangeType;  // only for descriptor tables
+    uint32_t numDescriptors;                // only for descriptor tables, UINT32_MAX for unbounded ranges
+};
+
+// Shader compiled at build time by precompile_shader, together with the compile parameters and the reflection
+struct PrecompiledShader
+{
+    const char* name;
+    const char* fileName;
+    const char* entrypoint;
+    const char* target;
+    const ShaderDefine* defines;
+    uint32_t defineCount;
+    const unsigned char* dxil;
+    size_t size;
+    uint32_t threadGroupSize[3];
+    const ShaderBinding* bindings;
+    uint32_t bindingCount;
+    const ShaderRootParameter* rootParameters;
+    uint32_t rootParameterCount;
+
+    // value of a define the shader was compiled with, nullptr if it wasn't defined
+    const char* FindDefine(const char* define) const
+    {
+        for (uint32_t i = 0; i < defineCount; i++)
+        {
+            if (strcmp(defines[i].name, define) == 0)
+            {
+                return defines[i].value;
+            }
+        }
+        return nullptr;
+    }
+
+    const ShaderBinding* FindBinding(const char* binding) const
+    {
+        for (uint32_t i = 0; i < bindingCount; i++)
+        {
+            if (strcmp(bindings[i].name, binding) == 0)
+            {
+                return &bindings[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // index of the root parameter to pass to SetBuffer, UINT32_MAX if the root signature has no such parameter
+    uint32_t FindRootParameter(D3D12_ROOT_PARAMETER_TYPE type, uint32_t shaderRegister, uint32_t registerSpace = 0) const
+    {
+        for (uint32_t i = 0; i < rootParameterCount; i++)
+        {
+            const ShaderRootParameter& parameter = rootParameters[i];
+            if (parameter.type == type && parameter.shaderRegister == shaderRegister && parameter.registerSpace == registerSpace)
+            {
+                return i;
+            }
+        }
+        return UINT32_MAX;
+    }
+
+    // root parameter the resource of a binding is bound to, either a root descriptor or a descriptor table
+    // whose first range holds the register, pass it to SetBuffer or SetTexture
+    uint32_t FindRootParameter(const ShaderBinding& binding) const
+    {
+        D3D12_DESCRIPTOR_RANGE_TYPE rangeType;
+        D3D12_ROOT_PARAMETER_TYPE rootType;
+        switch (binding.type)
+        {
+        case D3D_SIT_CBUFFER:
+            rangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+            rootType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+            break;
+        case D3D_SIT_TBUFFER:
+        case D3D_SIT_TEXTURE:
+        case D3D_SIT_STRUCTURED:
+        case D3D_SIT_BYTEADDRESS:
+            rangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+            rootType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+            break;
+        case D3D_SIT_SAMPLER:
+            rangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+            rootType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+            break;
+        default:
+            rangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+            rootType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+            break;
+        }
+
+        for (uint32_t i = 0; i < rootParameterCount; i++)
+        {
+            const ShaderRootParameter& parameter = rootParameters[i];
+            if (parameter.registerSpace != binding.space)
+            {
+                continue;
+            }
+
+            if (parameter.type == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+            {
+                bool inRange = binding.bindPoint >= parameter.shaderRegister &&
+                               (parameter.numDescriptors == UINT32_MAX || binding.bindPoint - parameter.shaderRegister < parameter.numDescriptors);
+                if (parameter.rangeType == rangeType && inRange)
+                {
+                    return i;
+                }
+            }
+            else if (parameter.type == rootType && parameter.shaderRegister == binding.bindPoint)
+            {
+                return i;
+            }
+        }
+        return UINT32_MAX;
+    }
+};
+
+// Requirements of a variant of a kernel, the shader sees them as the defines USE_WAVE_OPS, WAVE_SIZE,
+// USE_16BIT_TYPES, USE_INT64_ATOMICS, USE_INT64_TYPED_ATOMICS and USE_INT64_GROUPSHARED_ATOMICS
+struct ShaderVariant
+{
+    const char* name;
+    D3D_SHADER_MODEL shaderModel = D3D_SHADER_MODEL_6_0;
+    bool waveOps = false;
+    uint32_t waveSize = 0;      // compiled for [WaveSize(WAVE_SIZE)], 0 for any wave size
+    bool native16Bit = false;   // compiled with -enable-16bit-types
+    bool int64Atomics = false;  // 64 bit atomics on raw and structured buffers
+    bool int64TypedAtomics = false;         // 64 bit atomics on typed resources like RWTexture2D<uint64_t>
+    bool int64GroupSharedAtomics = false;   // 64 bit atomics on groupshared memory
+
+    D3D_SHADER_MODEL RequiredShaderModel() const
+    {
+        D3D_SHADER_MODEL required = shaderModel;
+        if (native16Bit && required < D3D_SHADER_MODEL_6_2)
+        {
+            required = D3D_SHADER_MODEL_6_2;
+        }
+        if ((waveSize != 0 || int64Atomics || int64TypedAtomics || int64GroupSharedAtomics) && required < D3D_SHADER_MODEL_6_6)
+        {
+            required = D3D_SHADER_MODEL_6_6;
+        }
+        return required;
+    }
+};
+
+struct DeviceCapabilities
+{
+    D3D_SHADER_MODEL highestShaderModel = D3D_SHADER_MODEL_5_1;
+    bool waveOps = false;
+    uint32_t waveLaneCountMin = 0;
+    uint32_t waveLaneCountMax = 0;
+    bool native16Bit = false;
+    bool int64Atomics = false;
+    bool int64TypedAtomics = false;
+    bool int64GroupSharedAtomics = false;
+    D3D12_TILED_RESOURCES_TIER tiledResourcesTier = D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED;
+
+    bool Supports(const ShaderVariant& variant) const
+    {
+        if (variant.RequiredShaderModel() > highestShaderModel)
+        {
+            return false;
+        }
+        if ((variant.waveOps || variant.waveSize != 0) && !waveOps)
+        {
+            return false;
+        }
+        if (variant.waveSize != 0 && (variant.waveSize < waveLaneCountMin || variant.waveSize > waveLaneCountMax))
+        {
+            return false;
+        }
+        if (variant.native16Bit && !native16Bit)
+        {
+            return false;
+        }
+        if (variant.int64Atomics && !int64Atomics)
+        {
+            return false;
+        }
+        if (variant.int64TypedAtomics && !int64TypedAtomics)
+        {
+            return false;
+        }
+        if (variant.int64GroupSharedAtomics && !int64GroupSharedAtomics)
+        {
+            return false;
+        }
+        return true;
+    }
+};
+
 struct ShaderCompilation
 {
     ComPtr<IDxcBlobEncoding> sourceBlob;
@@ -207,24 +788,507 @@ struct ShaderCompilation
     }
 };
 
-struct DX12Env
+// Records commands into its own allocator and list, use one context per recording thread
+// Contexts are submitted together with DX12Env::FlushQueue
+// Buffer states are tracked per context, the state a buffer is in before the first use in a context is only known
+// on submission, so FlushQueue resolves those transitions in the order the lists are executed
+struct CommandContext
 {
-    ComPtr<ID3D12Debug> d3d12Debug;
-    ComPtr<IDXGIFactory4> factory;
-    ComPtr<IDXGIAdapter1> adapter;
-    DXGI_ADAPTER_DESC1 adapterDesc;
-    ComPtr<ID3D12Device2> device;
-    D3D12_FEATURE_DATA_D3D12_OPTIONS1 options1 = {};
+    ComPtr<ID3D12CommandAllocator> commandAllocator;
+    ComPtr<ID3D12GraphicsCommandList> commandList;
+    ID3D12DescriptorHeap* boundDescriptorHeap = nullptr;
+    std::unordered_map<DX12Buffer*, D3D12_RESOURCE_STATES> bufferStates;               // state at the end of the recorded commands
+    std::vector<std::pair<DX12Buffer*, D3D12_RESOURCE_STATES>> initialBufferStates;    // state needed by the first use
+
+    void SetShader(Shader& shader)
+    {
+        commandList->SetComputeRootSignature(shader.rootSignature.Get());
+        commandList->SetPipelineState(shader.pso.Get());
+    }
+
+    void DispatchShader(uint32_t x, uint32_t y = 1, uint32_t z = 1)
+    {
+        commandList->Dispatch(x, y, z);
+    }
+
+
+    template<typename T>
+    ReadView<T> GetReadView(Buffer<T>& buffer)
+    {
+        T* data = nullptr;
+
+        if (buffer.flags & CPURead)
+        {
+            D3D12_RANGE range = { 0, (SIZE_T)(sizeof(T) * buffer.length) };
+
+            buffer.hostReadbackBuffer.buffer->Map(0, &range, reinterpret_cast<void**>(&data));
+        }
+
+        return { data, buffer.length, &buffer };
+    }
+
+    template<typename T>
+    WriteView<T> GetWriteView(Buffer<T>& buffer)
+    {
+        T* data = nullptr;
+
+        if (buffer.flags & CPUWrite)
+        {
+            D3D12_RANGE range = { 0, (SIZE_T)(sizeof(T) * buffer.length) };
+
+            buffer.hostUploadBuffer.buffer->Map(0, &range, reinterpret_cast<void**>(&data));
+        }
+        return { data, buffer.length, &buffer };
+    }
+
+    template<typename T>
+    void SetBuffer(uint32_t index, Buffer<T>& buffer)
+    {
+        if (buffer.flags & GPUConstant)
+        {
+            this->commandList->SetComputeRootConstantBufferView(index, buffer.gpuBuffer.buffer->GetGPUVirtualAddress());
+        }
+        else
+        {
+            this->commandList->SetComputeRootUnorderedAccessView(index, buffer.gpuBuffer.buffer->GetGPUVirtualAddress());
+        }
+    }
+    
+    // Transitions within this context, the first use of a buffer is only recorded and resolved by FlushQueue
+    // Never touches the buffer itself, so contexts on different threads can use the same buffers
+    void TransitionBuffer(DX12Buffer& buffer, D3D12_RESOURCE_STATES stateAfter)
+    {
+        auto known = bufferStates.find(&buffer);
+        if (known == bufferStates.end())
+        {
+            bufferStates[&buffer] = stateAfter;
+            initialBufferStates.push_back({ &buffer, stateAfter });
+            return;
+        }
+
+        if (known->second != stateAfter)
+        {
+            D3D12_RESOURCE_BARRIER barriers[1] = {};
+            barriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            barriers[0].Transition.pResource = buffer.buffer.Get();
+            barriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            barriers[0].Transition.StateBefore = known->second;
+            barriers[0].Transition.StateAfter = stateAfter;
+            this->commandList->ResourceBarrier(_countof(barriers), &barriers[0]);
+
+            known->second = stateAfter;
+        }
+    }
+
+    // Returns the barriers that bring the buffers from the state the earlier lists left them in to the state
+    // this list expects, and stores the states this list leaves them in
+    // Only called by FlushQueue, in the order the lists are executed
+    std::vector<D3D12_RESOURCE_BARRIER> ResolveBufferStates()
+    {
+        std::vector<D3D12_RESOURCE_BARRIER> barriers;
+        for (const std::pair<DX12Buffer*, D3D12_RESOURCE_STATES>& initial : initialBufferStates)
+        {
+            DX12Buffer* buffer = initial.first;
+            if (buffer->state != initial.second)
+            {
+                D3D12_RESOURCE_BARRIER barrier = {};
+                barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                barrier.Transition.pResource = buffer->buffer.Get();
+                barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+                barrier.Transition.StateBefore = buffer->state;
+                barrier.Transition.StateAfter = initial.second;
+                barriers.push_back(barrier);
+            }
+            else if (initial.second == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+            {
+                // an earlier list may have written the buffer without a transition to separate it from this list
+                D3D12_RESOURCE_BARRIER barrier = {};
+                barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+                barrier.UAV.pResource = buffer->buffer.Get();
+                barriers.push_back(barrier);
+            }
+        }
+
+        for (const std::pair<DX12Buffer* const, D3D12_RESOURCE_STATES>& current : bufferStates)
+        {
+            current.first->state = current.second;
+        }
+
+        return barriers;
+    }
+
+    void BufferToCopySrc(DX12Buffer& buffer)
+    {
+        TransitionBuffer(buffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    }
+
+    void BufferToReadWrite(DX12Buffer& buffer)
+    {
+        TransitionBuffer(buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    }
+
+    void BufferToCopyDest(DX12Buffer& buffer)
+    {
+        TransitionBuffer(buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    }
+
+    void BufferToConstant(DX12Buffer& buffer)
+    {
+        TransitionBuffer(buffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    }
+
+    void BufferToShaderResource(DX12Buffer& buffer)
+    {
+        TransitionBuffer(buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    }
+
+    template<typename T>
+    void UploadBuffer(Buffer<T>& buffer)
+    {
+        if ((buffer.flags & CPUWrite) == 0)
+        {
+            return; // error?
+        }
+
+        BufferToCopySrc(buffer.hostUploadBuffer);
+        BufferToCopyDest(buffer.gpuBuffer);
+
+        this->commandList->CopyResource(buffer.gpuBuffer.buffer.Get(), buffer.hostUploadBuffer.buffer.Get());
+
+        // setup for use, not necessarily will upload again
+        if (buffer.flags & GPUConstant)
+        {
+            BufferToConstant(buffer.gpuBuffer);
+        }
+        else
+        {
+            BufferToReadWrite(buffer.gpuBuffer);
+        }
+    }
+
+    template<typename T>
+    void UploadBufferRegion(Buffer<T>& buffer, uint64_t offset, uint64_t length)
+    {
+        if ((buffer.flags & CPUWrite) == 0 || length == 0)
+        {
+            return; // error?
+        }
+
+        BufferToCopySrc(buffer.hostUploadBuffer);
+        BufferToCopyDest(buffer.gpuBuffer);
+
+        this->commandList->CopyBufferRegion(buffer.gpuBuffer.buffer.Get(), sizeof(T) * offset, buffer.hostUploadBuffer.buffer.Get(), sizeof(T) * offset, sizeof(T) * length);
+
+        // setup for use, not necessarily will upload again
+        if (buffer.flags & GPUConstant)
+        {
+            BufferToConstant(buffer.gpuBuffer);
+        }
+        else
+        {
+            BufferToReadWrite(buffer.gpuBuffer);
+        }
+    }
+
+    template<typename T>
+    void ReadbackBuffer(Buffer<T>& buffer)
+    {
+        if ((buffer.flags & CPURead) == 0)
+        {
+            return; // error?
+        }
+
+        BufferToCopySrc(buffer.gpuBuffer);
+        BufferToCopyDest(buffer.hostReadbackBuffer);
+
+        this->commandList->CopyResource(buffer.hostReadbackBuffer.buffer.Get(), buffer.gpuBuffer.buffer.Get());
+
+        // setup for reuse, not necessarily will upload again
+        if (buffer.flags & GPUConstant)
+        {
+            BufferToConstant(buffer.gpuBuffer);
+        }
+        else
+        {
+            BufferToReadWrite(buffer.gpuBuffer);
+        }
+    }
+
+    template<typename T>
+    void ReadbackBufferRegion(Buffer<T>& buffer, uint64_t offset, uint64_t length)
+    {
+        if ((buffer.flags & CPURead) == 0 || length == 0)
+        {
+            return; // error?
+        }
+
+        BufferToCopySrc(buffer.gpuBuffer);
+        BufferToCopyDest(buffer.hostReadbackBuffer);
+
+        this->commandList->CopyBufferRegion(buffer.hostReadbackBuffer.buffer.Get(), sizeof(T) * offset, buffer.gpuBuffer.buffer.Get(), sizeof(T) * offset, sizeof(T) * length);
+
+        // setup for reuse, not necessarily will upload again
+        if (buffer.flags & GPUConstant)
+        {
+            BufferToConstant(buffer.gpuBuffer);
+        }
+        else
+        {
+            BufferToReadWrite(buffer.gpuBuffer);
+        }
+    }
+
+    // Records the upload, a single dispatch over all jobs and the readback of the outputs
+    // Expects the shader to be set, binds the batch to 4 consecutive root parameters starting at firstRootIndex:
+    // job table, group to job table, input arena and output arena
+    template<typename TIn, typename TOut>
+    void DispatchJobBatch(JobBatch<TIn, TOut>& batch, uint32_t firstRootIndex = 0)
+    {
+        if (batch.inFlight)
+        {
+            spdlog::error("Job batch is already in flight, flush the queue and get its results before dispatching it again");
+            return;
+        }
+
+        if (batch.IsEmpty())
+        {
+            return;
+        }
+
+        batch.inFlight = true;
+
+        WriteView<BatchJob> jobView = GetWriteView(batch.jobTable);
+        memcpy(jobView.data, batch.jobs.data(), sizeof(BatchJob) * batch.jobs.size());
+        jobView.Close();
+
+        WriteView<uint32_t> groupView = GetWriteView(batch.groupJobs);
+        for (uint32_t job = 0; job < (uint32_t)batch.jobs.size(); job++)
+        {
+            const BatchJob& entry = batch.jobs[job];
+            std::fill(groupView.data + entry.groupOffset, groupView.data + entry.groupOffset + entry.groupCount, job);
+        }
+        groupView.Close();
+
+        WriteView<TIn> inputView = GetWriteView(batch.inputArena);
+        memcpy(inputView.data, batch.inputs.data(), sizeof(TIn) * batch.inputs.size());
+        inputView.Close();
+
+        UploadBufferRegion(batch.jobTable, 0, (uint32_t)batch.jobs.size());
+        UploadBufferRegion(batch.groupJobs, 0, batch.groupCount);
+        UploadBufferRegion(batch.inputArena, 0, (uint32_t)batch.inputs.size());
+        BufferToReadWrite(batch.outputArena.gpuBuffer);
+
+        SetBuffer(firstRootIndex + 0, batch.jobTable);
+        SetBuffer(firstRootIndex + 1, batch.groupJobs);
+        SetBuffer(firstRootIndex + 2, batch.inputArena);
+        SetBuffer(firstRootIndex + 3, batch.outputArena);
+
+        DispatchShader(batch.groupCount);
+
+        ReadbackBufferRegion(batch.outputArena, 0, batch.outputLength);
+    }
+
+    template<typename T, uint32_t D>
+    TextureReadView<T> GetReadView(Texture<T, D>& texture)
+    {
+        uint8_t* data = nullptr;
+
+        if (texture.flags & CPURead)
+        {
+            texture.hostReadbackBuffer.buffer->Map(0, nullptr, reinterpret_cast<void**>(&data));
+        }
+
+        return { data, texture.footprint.Footprint.RowPitch, (uint64_t)texture.footprint.Footprint.RowPitch * texture.height, texture.hostReadbackBuffer.buffer.Get() };
+    }
+
+    template<typename T, uint32_t D>
+    TextureWriteView<T> GetWriteView(Texture<T, D>& texture)
+    {
+        uint8_t* data = nullptr;
+
+        if (texture.flags & CPUWrite)
+        {
+            D3D12_RANGE range = { 0, 0 };
+
+            texture.hostUploadBuffer.buffer->Map(0, &range, reinterpret_cast<void**>(&data));
+        }
+
+        return { data, texture.footprint.Footprint.RowPitch, (uint64_t)texture.footprint.Footprint.RowPitch * texture.height, texture.hostUploadBuffer.buffer.Get() };
+    }
+
+    void BindDescriptorHeap(ID3D12DescriptorHeap* heap)
+    {
+        if (boundDescriptorHeap != heap)
+        {
+            ID3D12DescriptorHeap* heaps[] = { heap };
+            this->commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+            boundDescriptorHeap = heap;
+        }
+    }
+
+    // Binds the texture as a read only descriptor table, to be read with Load or a sampler
+    template<typename T, uint32_t D>
+    void SetTexture(uint32_t index, Texture<T, D>& texture)
+    {
+        BufferToShaderResource(texture.gpuTexture);
+        BindDescriptorHeap(texture.descriptorHeap);
+
+        this->commandList->SetComputeRootDescriptorTable(index, texture.srvHandle);
+    }
+
+    // Binds the texture as a read write descriptor table
+    template<typename T, uint32_t D>
+    void SetRWTexture(uint32_t index, Texture<T, D>& texture)
+    {
+        BufferToReadWrite(texture.gpuTexture);
+        BindDescriptorHeap(texture.descriptorHeap);
+
+        this->commandList->SetComputeRootDescriptorTable(index, texture.uavHandle);
+    }
+
+    template<typename T, uint32_t D>
+    void UploadTexture(Texture<T, D>& texture)
+    {
+        if ((texture.flags & CPUWrite) == 0)
+        {
+            return; // error?
+        }
+
+        BufferToCopySrc(texture.hostUploadBuffer);
+        BufferToCopyDest(texture.gpuTexture);
+
+        D3D12_TEXTURE_COPY_LOCATION dst = {};
+        dst.pResource = texture.gpuTexture.buffer.Get();
+        dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dst.SubresourceIndex = 0;
+
+        D3D12_TEXTURE_COPY_LOCATION src = {};
+        src.pResource = texture.hostUploadBuffer.buffer.Get();
+        src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src.PlacedFootprint = texture.footprint;
+
+        this->commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+        // setup for use, not necessarily will upload again
+        BufferToReadWrite(texture.gpuTexture);
+    }
+
+    template<typename T, uint32_t D>
+    void ReadbackTexture(Texture<T, D>& texture)
+    {
+        if ((texture.flags & CPURead) == 0)
+        {
+            return; // error?
+        }
+
+        BufferToCopySrc(texture.gpuTexture);
+        BufferToCopyDest(texture.hostReadbackBuffer);
+
+        D3D12_TEXTURE_COPY_LOCATION dst = {};
+        dst.pResource = texture.hostReadbackBuffer.buffer.Get();
+        dst.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        dst.PlacedFootprint = texture.footprint;
+
+        D3D12_TEXTURE_COPY_LOCATION src = {};
+        src.pResource = texture.gpuTexture.buffer.Get();
+        src.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        src.SubresourceIndex = 0;
+
+        this->commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+        // setup for reuse, not necessarily will upload again
+        BufferToReadWrite(texture.gpuTexture);
+    }
+
+    // Records the passes of a compiled graph with only the barriers the graph compiler requires in between
+    // Imported buffers are moved to read write at the start, record their readbacks after the graph
+    void ExecuteGraph(ComputeGraph& graph)
+    {
+        if (!graph.IsCompiled())
+        {
+            spdlog::error("Can't execute a graph that isn't compiled, call CompileGraph after adding all buffers and passes");
+            exit(-1);
+        }
+
+        // orders the graph after earlier work on its buffers, including a previous execution of the same graph
+        D3D12_RESOURCE_BARRIER startBarrier = {};
+        startBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+        startBarrier.UAV.pResource = nullptr;
+        this->commandList->ResourceBarrier(1, &startBarrier);
+
+        for (uint32_t r = 0; r < (uint32_t)graph.importedBuffers.size(); r++)
+        {
+            if (graph.importedBuffers[r] && graph.compiled.IsUsed(r))
+            {
+                BufferToReadWrite(*graph.importedBuffers[r]);
+            }
+        }
+
+        ComputeGraphResources resources = { &graph, this };
+        std::vector<D3D12_RESOURCE_BARRIER> barriers;
+
+        for (const GraphStep& step : graph.compiled.steps)
+        {
+            barriers.clear();
+            for (const GraphBarrier& graphBarrier : step.barriers)
+            {
+                D3D12_RESOURCE_BARRIER barrier = {};
+                if (graphBarrier.type == GraphAliasingBarrier)
+                {
+                    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+                    barrier.Aliasing.pResourceBefore = nullptr;
+                    barrier.Aliasing.pResourceAfter = graph.GetResource(graphBarrier.resource);
+                }
+                else
+                {
+                    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+                    barrier.UAV.pResource = graph.GetResource(graphBarrier.resource);
+                }
+                barriers.push_back(barrier);
+            }
+
+            if (!barriers.empty())
+            {
+                this->commandList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+            }
+
+            graph.passFunctions[step.pass](*this, resources);
+        }
+    }
+
+    void Reset()
+    {
+        commandAllocator->Reset();
+        commandList->Reset(commandAllocator.Get(), nullptr);
+        boundDescriptorHeap = nullptr;
+        bufferStates.clear();
+        initialBufferStates.clear();
+    }
+};
+
+struct DX12Env : CommandContext
+{
+    ComPtr<ID3D12Debug> d3d12Debug;
+    ComPtr<IDXGIFactory4> factory;
+    ComPtr<IDXGIAdapter1> adapter;
+    DXGI_ADAPTER_DESC1 adapterDesc;
+    ComPtr<ID3D12Device2> device;
+    D3D12_FEATURE_DATA_D3D12_OPTIONS1 options1 = {};
+    DeviceCapabilities capabilities;
     ComPtr<IDxcLibrary> library;
     ComPtr<IDxcCompiler> compiler;
     ComPtr<IDxcIncludeHandler> includeHandler;
     ComPtr<IDxcUtils> utils;
     ComPtr<ID3D12InfoQueue> infoQueue;
     ComPtr<ID3D12CommandQueue> queue;
-    ComPtr<ID3D12CommandAllocator> commandAllocator;
-    ComPtr<ID3D12GraphicsCommandList> commandList;
+    DescriptorHeap descriptorHeap;
+    TilePool tilePool;
+    ComPtr<ID3D12CommandAllocator> transitionAllocator;
+    std::vector<ComPtr<ID3D12GraphicsCommandList>> transitionLists;    // lists with the resolved transitions, one per context that needs them
 
-    static DX12Env InitializeDX12()
+    // Without loadCompiler only precompiled shaders can be used, but dxcompiler.dll is never loaded
+    static DX12Env InitializeDX12(bool loadCompiler = true)
     {
         spdlog::set_pattern("[%H:%M:%S %z] [%n] [%^---%L---%$] %v");
         spdlog::info("Initialized Logger");
@@ -266,21 +1330,28 @@ struct DX12Env
         D3D12_FEATURE_DATA_D3D12_OPTIONS1 options1 = {};
         device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS1, &options1, sizeof(D3D12_FEATURE_DATA_D3D12_OPTIONS1));
 
-        // create library
-        ComPtr<IDxcLibrary> library;
-        DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&library));
+        DeviceCapabilities capabilities = QueryCapabilities(device, options1);
 
-        // create compiler
+        ComPtr<IDxcLibrary> library;
         ComPtr<IDxcCompiler> compiler;
-        DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler));
-
-        // more utils
         ComPtr<IDxcUtils> utils;
-        DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils));
-
-        // include handler for different files
         ComPtr<IDxcIncludeHandler> includeHandler;
-        utils->CreateDefaultIncludeHandler(&includeHandler);
+
+        // dxcompiler.dll is delay loaded, so it is only loaded here
+        if (loadCompiler)
+        {
+            // create library
+            DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&library));
+
+            // create compiler
+            DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler));
+
+            // more utils
+            DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils));
+
+            // include handler for different files
+            utils->CreateDefaultIncludeHandler(&includeHandler);
+        }
 
         D3D12_COMMAND_QUEUE_DESC queueDesc = {};
         queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
@@ -289,6 +1360,17 @@ struct DX12Env
         ComPtr<ID3D12CommandQueue> commandQueue;
         device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&commandQueue));
 
+        // shader visible heap for the descriptors of textures
+        D3D12_DESCRIPTOR_HEAP_DESC descriptorHeapDesc = {};
+        descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+        descriptorHeapDesc.NumDescriptors = 4096;
+        descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+
+        DescriptorHeap descriptorHeap;
+        device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&descriptorHeap.heap));
+        descriptorHeap.descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        descriptorHeap.capacity = descriptorHeapDesc.NumDescriptors;
+
         ComPtr<ID3D12CommandAllocator> commandAllocator;
         device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator));
 
@@ -302,26 +1384,87 @@ struct DX12Env
         spdlog::info("");
         spdlog::info("");
 
-        return DX12Env{
-            d3d12Debug,
-            factory,
-            adapter,
-            adapterDesc,
-            device,
-            options1,
-            library,
-            compiler,
-            includeHandler,
-            utils,
-            infoQueue,
-            commandQueue,
-            commandAllocator,
-            commandList
-        };
+        return DX12Env{
+            { commandAllocator, commandList },
+            d3d12Debug,
+            factory,
+            adapter,
+            adapterDesc,
+            device,
+            options1,
+            capabilities,
+            library,
+            compiler,
+            includeHandler,
+            utils,
+            infoQueue,
+            commandQueue,
+            descriptorHeap
+        };
+    }
+
+    static DeviceCapabilities QueryCapabilities(ComPtr<ID3D12Device2>& device, D3D12_FEATURE_DATA_D3D12_OPTIONS1& options1)
+    {
+        DeviceCapabilities capabilities;
+        capabilities.waveOps = options1.WaveOps;
+        capabilities.waveLaneCountMin = options1.WaveLaneCountMin;
+        capabilities.waveLaneCountMax = options1.WaveLaneCountMax;
+
+        D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+        if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(D3D12_FEATURE_DATA_D3D12_OPTIONS))))
+        {
+            capabilities.tiledResourcesTier = options.TiledResourcesTier;
+        }
+
+        // the runtime rejects shader models it doesn't know, so walk down until it accepts one
+        D3D12_FEATURE_DATA_SHADER_MODEL shaderModel = {};
+        for (uint32_t model = D3D_SHADER_MODEL_6_7; model >= D3D_SHADER_MODEL_6_0; model--)
+        {
+            shaderModel.HighestShaderModel = (D3D_SHADER_MODEL)model;
+            if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shaderModel, sizeof(D3D12_FEATURE_DATA_SHADER_MODEL))))
+            {
+                capabilities.highestShaderModel = shaderModel.HighestShaderModel;
+                break;
+            }
+        }
+
+        D3D12_FEATURE_DATA_D3D12_OPTIONS4 options4 = {};
+        if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS4, &options4, sizeof(D3D12_FEATURE_DATA_D3D12_OPTIONS4))))
+        {
+            capabilities.native16Bit = options4.Native16BitShaderOpsSupported;
+        }
+
+        D3D12_FEATURE_DATA_D3D12_OPTIONS9 options9 = {};
+        if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS9, &options9, sizeof(D3D12_FEATURE_DATA_D3D12_OPTIONS9))))
+        {
+            capabilities.int64TypedAtomics = options9.AtomicInt64OnTypedResourceSupported;
+            capabilities.int64GroupSharedAtomics = options9.AtomicInt64OnGroupSharedSupported;
+        }
+
+        // 64 bit atomics on raw and structured buffers are required from shader model 6.6
+        capabilities.int64Atomics = capabilities.highestShaderModel >= D3D_SHADER_MODEL_6_6;
+
+        spdlog::info("Shader model: {}.{}", capabilities.highestShaderModel >> 4, capabilities.highestShaderModel & 0xf);
+        spdlog::info("Wave lanes: {} - {}", capabilities.waveLaneCountMin, capabilities.waveLaneCountMax);
+        spdlog::info("Native 16 bit: {}, int64 atomics: {}, typed: {}, groupshared: {}", capabilities.native16Bit, capabilities.int64Atomics, capabilities.int64TypedAtomics, capabilities.int64GroupSharedAtomics);
+        spdlog::info("Tiled resources tier: {}", (uint32_t)capabilities.tiledResourcesTier);
+
+        return capabilities;
+    }
+
+    static std::wstring ComputeProfile(D3D_SHADER_MODEL shaderModel)
+    {
+        return L"cs_" + std::to_wstring(shaderModel >> 4) + L"_" + std::to_wstring(shaderModel & 0xf);
     }
 
-    ShaderCompilation CreateShaderCompilation(LPCWSTR fileName, LPCWSTR entrypoint, ShaderDefines& defines)
+    ShaderCompilation CreateShaderCompilation(LPCWSTR fileName, LPCWSTR entrypoint, ShaderDefines& defines, LPCWSTR target = L"cs_6_7", const std::vector<LPCWSTR>& extraArguments = {})
     {
+        if (!compiler)
+        {
+            spdlog::error("Can't compile shaders, dx12 was initialized without the compiler");
+            exit(-1);
+        }
+
         // switch cwd
         ShaderPathUtil pathUtil;
 
@@ -331,18 +1474,19 @@ struct DX12Env
         library->CreateBlobFromFile(fileName, &codePage, &sourceBlob);
 
         ComPtr<IDxcOperationResult> result;
-        LPCWSTR arguments[] =
+        std::vector<LPCWSTR> arguments =
         {
             L"-O3",
             L"-HV 2021",
             L"-I /Shaders"
             // L"-Zi",
         };
+        arguments.insert(arguments.end(), extraArguments.begin(), extraArguments.end());
 
         DxcDefine* defs = defines.defines.data();
         uint32_t numDefines = (uint32_t)defines.defines.size();
 
-        HRESULT hr = compiler->Compile(sourceBlob.Get(), fileName, entrypoint, L"cs_6_7", arguments, _countof(arguments), defs, numDefines, includeHandler.Get(), &result);
+        HRESULT hr = compiler->Compile(sourceBlob.Get(), fileName, entrypoint, target, arguments.data(), (uint32_t)arguments.size(), defs, numDefines, includeHandler.Get(), &result);
         if (SUCCEEDED(hr))
             result->GetStatus(&hr);
         bool compileSuccess = SUCCEEDED(hr);
@@ -361,58 +1505,465 @@ struct DX12Env
             };
         }
 
-        // retrieve compiled result
-        ComPtr<IDxcBlob> shaderBlob;
-        result->GetResult(&shaderBlob);
+        // retrieve compiled result
+        ComPtr<IDxcBlob> shaderBlob;
+        result->GetResult(&shaderBlob);
+
+        // get reflection code
+        DxcBuffer dxcBuffer{ .Ptr = shaderBlob->GetBufferPointer(), .Size = shaderBlob->GetBufferSize(), .Encoding = DXC_CP_ACP };
+        ComPtr<ID3D12ShaderReflection> shaderReflection;
+        utils->CreateReflection(&dxcBuffer, IID_PPV_ARGS(&shaderReflection));
+
+        ComPtr<IDxcBlobEncoding> disassembleBlob;
+        compiler->Disassemble(shaderBlob.Get(), &disassembleBlob);
+
+        return{
+            sourceBlob,
+            errorBlob,
+            shaderReflection,
+            disassembleBlob,
+            shaderBlob,
+            compileSuccess
+        };
+    }
+
+    Shader CompileShader(LPCWSTR fileName, LPCWSTR entrypoint, ShaderDefines& defines)
+    {
+        ShaderCompilation shaderCompile = CreateShaderCompilation(fileName, entrypoint, defines);
+
+        if (!shaderCompile.compileSuccess)
+        {
+            shaderCompile.PrintCompilationErrors();
+
+            exit(-1);
+        }
+
+        return shaderCompile.GetShader(*this);
+    }
+
+    Shader LoadPrecompiledShader(const PrecompiledShader& precompiled)
+    {
+        ComPtr<ID3D12RootSignature> rootSignature;
+        HRESULT hr = device->CreateRootSignature(0, precompiled.dxil, precompiled.size, IID_PPV_ARGS(&rootSignature));
+
+        ComPtr<ID3D12PipelineState> pso;
+        if (SUCCEEDED(hr))
+        {
+            D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+            psoDesc.pRootSignature = rootSignature.Get();
+            psoDesc.CS.BytecodeLength = precompiled.size;
+            psoDesc.CS.pShaderBytecode = precompiled.dxil;
+
+            hr = device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&pso));
+        }
+
+        if (FAILED(hr))
+        {
+            spdlog::error("Failed to load precompiled shader {} ({} {} {})", precompiled.name, precompiled.fileName, precompiled.entrypoint, precompiled.target);
+            exit(-1);
+        }
+
+        // there is no blob from the compiler, the dxil stays in the executable
+        return {
+            nullptr,
+            rootSignature,
+            pso
+        };
+    }
+
+    // Compiles the first variant the device supports, variants should be ordered from fastest to the slowest fallback
+    // Falls back to the next supported variant if a variant fails to compile
+    Shader CompileShaderVariants(LPCWSTR fileName, LPCWSTR entrypoint, const std::vector<ShaderVariant>& variants, ShaderDefines& defines, uint32_t* selectedVariant = nullptr)
+    {
+        for (uint32_t i = 0; i < (uint32_t)variants.size(); i++)
+        {
+            const ShaderVariant& variant = variants[i];
+            if (!capabilities.Supports(variant))
+            {
+                continue;
+            }
+
+            ShaderDefines variantDefines = defines;
+            variantDefines.AddDefine(L"USE_WAVE_OPS", (uint32_t)(variant.waveOps || variant.waveSize != 0));
+            variantDefines.AddDefine(L"WAVE_SIZE", variant.waveSize);
+            variantDefines.AddDefine(L"USE_16BIT_TYPES", (uint32_t)variant.native16Bit);
+            variantDefines.AddDefine(L"USE_INT64_ATOMICS", (uint32_t)variant.int64Atomics);
+            variantDefines.AddDefine(L"USE_INT64_TYPED_ATOMICS", (uint32_t)variant.int64TypedAtomics);
+            variantDefines.AddDefine(L"USE_INT64_GROUPSHARED_ATOMICS", (uint32_t)variant.int64GroupSharedAtomics);
+
+            std::vector<LPCWSTR> extraArguments;
+            if (variant.native16Bit)
+            {
+                extraArguments.push_back(L"-enable-16bit-types");
+            }
+
+            // compile against the highest supported model, the variant only states the minimum
+            std::wstring target = ComputeProfile(capabilities.highestShaderModel);
+            ShaderCompilation shaderCompile = CreateShaderCompilation(fileName, entrypoint, variantDefines, target.c_str(), extraArguments);
+
+            if (!shaderCompile.compileSuccess)
+            {
+                spdlog::warn("Shader variant {} failed to compile, trying the next variant", variant.name);
+                shaderCompile.PrintCompilationErrors();
+                continue;
+            }
+
+            spdlog::info("Using shader variant {}", variant.name);
+            if (selectedVariant)
+            {
+                *selectedVariant = i;
+            }
+
+            return shaderCompile.GetShader(*this);
+        }
+
+        spdlog::error("No supported shader variant could be compiled");
+        exit(-1);
+    }
+
+    template<typename T>
+    Buffer<T> CreateBuffer(uint64_t length, BufferFlags flags)
+    {
+        D3D12_RESOURCE_DESC gpuDesc = {};
+        gpuDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        gpuDesc.Alignment = 0;
+        gpuDesc.Width = sizeof(T) * length;
+        gpuDesc.Height = 1;
+        gpuDesc.DepthOrArraySize = 1;
+        gpuDesc.MipLevels = 1;
+        gpuDesc.Format = DXGI_FORMAT_UNKNOWN;
+        gpuDesc.SampleDesc.Count = 1;
+        gpuDesc.SampleDesc.Quality = 0;
+        gpuDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        gpuDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    
+        D3D12_HEAP_PROPERTIES gpuProperties = {};
+        gpuProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+        gpuProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+        gpuProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        gpuProperties.CreationNodeMask = 0;
+        gpuProperties.VisibleNodeMask = 0;
+
+        D3D12_RESOURCE_STATES gpuState = D3D12_RESOURCE_STATE_COMMON;
+
+        if (flags & GPUConstant)
+        {
+            gpuDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        }
+
+        ComPtr<ID3D12Resource> mGPUResource;
+        if (flags & Reserved)
+        {
+            // only reserves the address range, memory is committed per tile with CommitTiles
+            // host buffers would have to cover the whole range, so reserved buffers don't get them
+            if (flags & (CPURead | CPUWrite))
+            {
+                spdlog::warn("Reserved buffers can't be read or written by the CPU, ignoring CPURead and CPUWrite");
+                flags = (BufferFlags)(flags & ~(CPURead | CPUWrite));
+            }
+
+            if (capabilities.tiledResourcesTier == D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED)
+            {
+                spdlog::error("Can't create reserved buffer, the device doesn't support tiled resources");
+                exit(-1);
+            }
+
+            // below tier 2 reading uncommitted tiles is undefined instead of returning zero
+            if (capabilities.tiledResourcesTier < D3D12_TILED_RESOURCES_TIER_2)
+            {
+                spdlog::warn("Tiled resources tier 1, reserved buffers must not access uncommitted tiles");
+            }
+
+            if (FAILED(this->device->CreateReservedResource(&gpuDesc, gpuState, nullptr, IID_PPV_ARGS(&mGPUResource))))
+            {
+                spdlog::error("Failed to create reserved buffer of {} bytes", sizeof(T) * length);
+                exit(-1);
+            }
+        }
+        else
+        {
+            this->device->CreateCommittedResource(&gpuProperties, D3D12_HEAP_FLAG_NONE, &gpuDesc, gpuState, nullptr, IID_PPV_ARGS(&mGPUResource));
+        }
+
+        D3D12_RESOURCE_STATES hostUploadState = D3D12_RESOURCE_STATE_COPY_SOURCE;
+        D3D12_RESOURCE_STATES hostReadbackState = D3D12_RESOURCE_STATE_COPY_DEST;
+        ComPtr<ID3D12Resource> mHostUploadResource;
+        ComPtr<ID3D12Resource> mHostReadbackResource;
+
+        if (flags & CPUWrite)
+        {
+            D3D12_RESOURCE_DESC cpuDesc = {};
+            cpuDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+            cpuDesc.Alignment = 0;
+            cpuDesc.Width = sizeof(T) * length;
+            cpuDesc.Height = 1;
+            cpuDesc.DepthOrArraySize = 1;
+            cpuDesc.MipLevels = 1;
+            cpuDesc.Format = DXGI_FORMAT_UNKNOWN;
+            cpuDesc.SampleDesc.Count = 1;
+            cpuDesc.SampleDesc.Quality = 0;
+            cpuDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+            cpuDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+            D3D12_HEAP_PROPERTIES cpuProperties = {};
+            cpuProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
+            cpuProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+            cpuProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+            cpuProperties.CreationNodeMask = 0;
+            cpuProperties.VisibleNodeMask = 0;
+
+            this->device->CreateCommittedResource(&cpuProperties, D3D12_HEAP_FLAG_NONE, &cpuDesc, hostUploadState, nullptr, IID_PPV_ARGS(&mHostUploadResource));
+        }    
+
+        if (flags & CPURead)
+        {
+            D3D12_RESOURCE_DESC cpuDesc = {};
+            cpuDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+            cpuDesc.Alignment = 0;
+            cpuDesc.Width = sizeof(T) * length;
+            cpuDesc.Height = 1;
+            cpuDesc.DepthOrArraySize = 1;
+            cpuDesc.MipLevels = 1;
+            cpuDesc.Format = DXGI_FORMAT_UNKNOWN;
+            cpuDesc.SampleDesc.Count = 1;
+            cpuDesc.SampleDesc.Quality = 0;
+            cpuDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+            cpuDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+            D3D12_HEAP_PROPERTIES cpuProperties = {};
+            cpuProperties.Type = D3D12_HEAP_TYPE_READBACK;
+            cpuProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+            cpuProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+            cpuProperties.CreationNodeMask = 0;
+            cpuProperties.VisibleNodeMask = 0;
+
+            this->device->CreateCommittedResource(&cpuProperties, D3D12_HEAP_FLAG_NONE, &cpuDesc, hostReadbackState, nullptr, IID_PPV_ARGS(&mHostReadbackResource));
+        }
+        
+        return {
+            { mGPUResource, gpuState },
+            { mHostUploadResource, hostUploadState },
+            { mHostReadbackResource, hostReadbackState },
+            length,
+            flags,
+        };
+    }
+
+    // Commits the tiles covering the elements [offset, offset + length) of a reserved buffer
+    // The mappings are updated on the queue, so they are in place for all work flushed afterwards
+    template<typename T>
+    void CommitTiles(Buffer<T>& buffer, uint64_t offset, uint64_t length)
+    {
+        if ((buffer.flags & Reserved) == 0 || !ClampTileRange(buffer, offset, length))
+        {
+            return;
+        }
+
+        uint64_t firstTile = sizeof(T) * offset / D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+        uint64_t lastTile = (sizeof(T) * (offset + length) - 1) / D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
+        std::vector<std::pair<uint64_t, uint32_t>> tiles;
+        for (uint64_t tile = firstTile; tile <= lastTile; tile++)
+        {
+            if (buffer.committedTiles.find(tile) == buffer.committedTiles.end())
+            {
+                uint32_t poolTile = AllocateTile();
+                buffer.committedTiles[tile] = poolTile;
+                tiles.push_back({ tile, poolTile });
+            }
+        }
+
+        UpdateTileMappings(buffer.gpuBuffer.buffer.Get(), tiles, false);
+    }
+
+    // Returns the tiles completely inside the elements [offset, offset + length) of a reserved buffer to the pool
+    // Partially covered tiles are kept, as they may still hold other elements
+    // Call this after the work using the tiles has been flushed, the unmapping is executed on the queue right away
+    template<typename T>
+    void DecommitTiles(Buffer<T>& buffer, uint64_t offset, uint64_t length)
+    {
+        if ((buffer.flags & Reserved) == 0 || !ClampTileRange(buffer, offset, length))
+        {
+            return;
+        }
+
+        uint64_t firstTile = (sizeof(T) * offset + D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES - 1) / D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+        uint64_t endTile = sizeof(T) * (offset + length) / D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+        if (offset + length == buffer.length)
+        {
+            endTile = (sizeof(T) * buffer.length + D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES - 1) / D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+        }
+
+        std::vector<std::pair<uint64_t, uint32_t>> tiles;
+        for (uint64_t tile = firstTile; tile < endTile; tile++)
+        {
+            auto committed = buffer.committedTiles.find(tile);
+            if (committed != buffer.committedTiles.end())
+            {
+                tiles.push_back(*committed);
+                buffer.committedTiles.erase(committed);
+            }
+        }
+
+        UpdateTileMappings(buffer.gpuBuffer.buffer.Get(), tiles, true);
+
+        for (const std::pair<uint64_t, uint32_t>& tile : tiles)
+        {
+            tilePool.freeTiles.push_back(tile.second);
+            tilePool.usedTiles--;
+        }
+    }
+
+    // Releases the heaps of the pool of which no tile is committed anymore
+    // Only call this after the work that used those tiles has been flushed
+    void TrimTilePool()
+    {
+        std::vector<uint32_t> freeCount(tilePool.heaps.size(), 0);
+        for (uint32_t tile : tilePool.freeTiles)
+        {
+            freeCount[tile / tilePool.tilesPerHeap]++;
+        }
+
+        for (uint32_t heap = 0; heap < (uint32_t)tilePool.heaps.size(); heap++)
+        {
+            if (tilePool.heaps[heap] && freeCount[heap] == tilePool.tilesPerHeap)
+            {
+                tilePool.heaps[heap] = nullptr;
+            }
+        }
+
+        std::erase_if(tilePool.freeTiles, [&](uint32_t tile) { return !tilePool.heaps[tile / tilePool.tilesPerHeap]; });
+    }
+
+    // Limits the elements [offset, offset + length) to the buffer, returns false if nothing is left
+    template<typename T>
+    static bool ClampTileRange(const Buffer<T>& buffer, uint64_t& offset, uint64_t& length)
+    {
+        if (offset >= buffer.length)
+        {
+            spdlog::warn("Tile range starts at element {}, past the end of the buffer of {} elements", offset, buffer.length);
+            return false;
+        }
+
+        if (length > buffer.length - offset)
+        {
+            length = buffer.length - offset;
+        }
+
+        return length != 0;
+    }
+
+    uint32_t AllocateTile()
+    {
+        if (tilePool.freeTiles.empty())
+        {
+            D3D12_HEAP_DESC heapDesc = {};
+            heapDesc.SizeInBytes = (UINT64)tilePool.tilesPerHeap * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+            heapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+            heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+            heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+            heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+            heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+
+            ComPtr<ID3D12Heap> heap;
+            if (FAILED(this->device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap))))
+            {
+                spdlog::error("Failed to create a tile pool heap of {} bytes, {} tiles are in use", heapDesc.SizeInBytes, tilePool.usedTiles);
+                exit(-1);
+            }
+
+            // reuse the slot of a trimmed heap, so tile indices stay small
+            uint32_t heapIndex = 0;
+            while (heapIndex < (uint32_t)tilePool.heaps.size() && tilePool.heaps[heapIndex])
+            {
+                heapIndex++;
+            }
 
-        // get reflection code
-        DxcBuffer dxcBuffer{ .Ptr = shaderBlob->GetBufferPointer(), .Size = shaderBlob->GetBufferSize(), .Encoding = DXC_CP_ACP };
-        ComPtr<ID3D12ShaderReflection> shaderReflection;
-        utils->CreateReflection(&dxcBuffer, IID_PPV_ARGS(&shaderReflection));
+            if (heapIndex == (uint32_t)tilePool.heaps.size())
+            {
+                tilePool.heaps.push_back(heap);
+            }
+            else
+            {
+                tilePool.heaps[heapIndex] = heap;
+            }
 
-        ComPtr<IDxcBlobEncoding> disassembleBlob;
-        compiler->Disassemble(shaderBlob.Get(), &disassembleBlob);
+            // reversed, so the tiles of a heap are handed out in order
+            for (uint32_t tile = tilePool.tilesPerHeap; tile-- > 0;)
+            {
+                tilePool.freeTiles.push_back(heapIndex * tilePool.tilesPerHeap + tile);
+            }
+        }
 
-        return{
-            sourceBlob,
-            errorBlob,
-            shaderReflection,
-            disassembleBlob,
-            shaderBlob,
-            compileSuccess
-        };
+        uint32_t tile = tilePool.freeTiles.back();
+        tilePool.freeTiles.pop_back();
+        tilePool.usedTiles++;
+        return tile;
     }
 
-    Shader CompileShader(LPCWSTR fileName, LPCWSTR entrypoint, ShaderDefines& defines)
+    // Maps every tile of the resource to its tile in the pool, or to nothing when unmapping
+    // Every heap needs its own update, so the tiles are grouped per heap
+    void UpdateTileMappings(ID3D12Resource* resource, const std::vector<std::pair<uint64_t, uint32_t>>& tiles, bool unmap)
     {
-        ShaderCompilation shaderCompile = CreateShaderCompilation(fileName, entrypoint, defines);
+        std::unordered_map<uint32_t, std::vector<std::pair<uint64_t, uint32_t>>> heapTiles;
+        for (const std::pair<uint64_t, uint32_t>& tile : tiles)
+        {
+            heapTiles[unmap ? 0 : tile.second / tilePool.tilesPerHeap].push_back(tile);
+        }
 
-        if (!shaderCompile.compileSuccess)
+        for (const auto& [heap, mappings] : heapTiles)
         {
-            shaderCompile.PrintCompilationErrors();
+            std::vector<D3D12_TILED_RESOURCE_COORDINATE> coordinates(mappings.size());
+            std::vector<D3D12_TILE_REGION_SIZE> regionSizes(mappings.size());
+            std::vector<D3D12_TILE_RANGE_FLAGS> rangeFlags(mappings.size(), unmap ? D3D12_TILE_RANGE_FLAG_NULL : D3D12_TILE_RANGE_FLAG_NONE);
+            std::vector<UINT> heapOffsets(mappings.size());
+            std::vector<UINT> rangeTileCounts(mappings.size(), 1);
 
-            exit(-1);
+            for (size_t i = 0; i < mappings.size(); i++)
+            {
+                coordinates[i] = { (UINT)mappings[i].first, 0, 0, 0 };
+                regionSizes[i] = { 1, FALSE, 0, 0, 0 };
+                heapOffsets[i] = mappings[i].second % tilePool.tilesPerHeap;
+            }
+
+            queue->UpdateTileMappings(
+                resource,
+                (UINT)mappings.size(), coordinates.data(), regionSizes.data(),
+                unmap ? nullptr : tilePool.heaps[heap].Get(),
+                (UINT)mappings.size(), rangeFlags.data(), heapOffsets.data(), rangeTileCounts.data(),
+                D3D12_TILE_MAPPING_FLAG_NONE);
         }
+    }
 
-        return shaderCompile.GetShader(*this);
+    template<typename T>
+    Texture2D<T> CreateTexture2D(uint32_t width, uint32_t height, BufferFlags flags, DXGI_FORMAT format = TextureFormat<T>::format)
+    {
+        return CreateTexture<T, 2>(width, height, 1, flags, format);
     }
 
     template<typename T>
-    Buffer<T> CreateBuffer(uint32_t length, BufferFlags flags)
+    Texture3D<T> CreateTexture3D(uint32_t width, uint32_t height, uint32_t depth, BufferFlags flags, DXGI_FORMAT format = TextureFormat<T>::format)
     {
+        return CreateTexture<T, 3>(width, height, depth, flags, format);
+    }
+
+    template<typename T, uint32_t D>
+    Texture<T, D> CreateTexture(uint32_t width, uint32_t height, uint32_t depth, BufferFlags flags, DXGI_FORMAT format)
+    {
+        // unknown layout lets the driver pick its tiled layout
         D3D12_RESOURCE_DESC gpuDesc = {};
-        gpuDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        gpuDesc.Dimension = D == 3 ? D3D12_RESOURCE_DIMENSION_TEXTURE3D : D3D12_RESOURCE_DIMENSION_TEXTURE2D;
         gpuDesc.Alignment = 0;
-        gpuDesc.Width = sizeof(T) * length;
-        gpuDesc.Height = 1;
-        gpuDesc.DepthOrArraySize = 1;
+        gpuDesc.Width = width;
+        gpuDesc.Height = height;
+        gpuDesc.DepthOrArraySize = (UINT16)depth;
         gpuDesc.MipLevels = 1;
-        gpuDesc.Format = DXGI_FORMAT_UNKNOWN;
+        gpuDesc.Format = format;
         gpuDesc.SampleDesc.Count = 1;
         gpuDesc.SampleDesc.Quality = 0;
-        gpuDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        gpuDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
         gpuDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-    
+
         D3D12_HEAP_PROPERTIES gpuProperties = {};
         gpuProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
         gpuProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
@@ -422,9 +1973,17 @@ struct DX12Env
 
         D3D12_RESOURCE_STATES gpuState = D3D12_RESOURCE_STATE_COMMON;
 
-        if (flags & GPUConstant)
+        // the host buffers are row major with rows aligned to the copy pitch
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+        UINT64 rowSize = 0;
+        UINT64 totalBytes = 0;
+        this->device->GetCopyableFootprints(&gpuDesc, 0, 1, 0, &footprint, nullptr, &rowSize, &totalBytes);
+
+        // the views step sizeof(T) per texel, so the format has to match T
+        if (rowSize != (uint64_t)width * sizeof(T))
         {
-            gpuDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+            spdlog::error("Texture format {} doesn't match the element size of {} bytes", (uint32_t)format, sizeof(T));
+            exit(-1);
         }
 
         ComPtr<ID3D12Resource> mGPUResource;
@@ -435,83 +1994,144 @@ struct DX12Env
         ComPtr<ID3D12Resource> mHostUploadResource;
         ComPtr<ID3D12Resource> mHostReadbackResource;
 
+        D3D12_RESOURCE_DESC cpuDesc = {};
+        cpuDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        cpuDesc.Alignment = 0;
+        cpuDesc.Width = totalBytes;
+        cpuDesc.Height = 1;
+        cpuDesc.DepthOrArraySize = 1;
+        cpuDesc.MipLevels = 1;
+        cpuDesc.Format = DXGI_FORMAT_UNKNOWN;
+        cpuDesc.SampleDesc.Count = 1;
+        cpuDesc.SampleDesc.Quality = 0;
+        cpuDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        cpuDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+        D3D12_HEAP_PROPERTIES cpuProperties = {};
+        cpuProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+        cpuProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        cpuProperties.CreationNodeMask = 0;
+        cpuProperties.VisibleNodeMask = 0;
+
         if (flags & CPUWrite)
         {
-            D3D12_RESOURCE_DESC cpuDesc = {};
-            cpuDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-            cpuDesc.Alignment = 0;
-            cpuDesc.Width = sizeof(T) * length;
-            cpuDesc.Height = 1;
-            cpuDesc.DepthOrArraySize = 1;
-            cpuDesc.MipLevels = 1;
-            cpuDesc.Format = DXGI_FORMAT_UNKNOWN;
-            cpuDesc.SampleDesc.Count = 1;
-            cpuDesc.SampleDesc.Quality = 0;
-            cpuDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-            cpuDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-            D3D12_HEAP_PROPERTIES cpuProperties = {};
             cpuProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
-            cpuProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-            cpuProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-            cpuProperties.CreationNodeMask = 0;
-            cpuProperties.VisibleNodeMask = 0;
-
             this->device->CreateCommittedResource(&cpuProperties, D3D12_HEAP_FLAG_NONE, &cpuDesc, hostUploadState, nullptr, IID_PPV_ARGS(&mHostUploadResource));
-        }    
+        }
 
         if (flags & CPURead)
         {
-            D3D12_RESOURCE_DESC cpuDesc = {};
-            cpuDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-            cpuDesc.Alignment = 0;
-            cpuDesc.Width = sizeof(T) * length;
-            cpuDesc.Height = 1;
-            cpuDesc.DepthOrArraySize = 1;
-            cpuDesc.MipLevels = 1;
-            cpuDesc.Format = DXGI_FORMAT_UNKNOWN;
-            cpuDesc.SampleDesc.Count = 1;
-            cpuDesc.SampleDesc.Quality = 0;
-            cpuDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-            cpuDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-            D3D12_HEAP_PROPERTIES cpuProperties = {};
             cpuProperties.Type = D3D12_HEAP_TYPE_READBACK;
-            cpuProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-            cpuProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-            cpuProperties.CreationNodeMask = 0;
-            cpuProperties.VisibleNodeMask = 0;
-
             this->device->CreateCommittedResource(&cpuProperties, D3D12_HEAP_FLAG_NONE, &cpuDesc, hostReadbackState, nullptr, IID_PPV_ARGS(&mHostReadbackResource));
         }
-        
+
+        // one descriptor to read write and one to read, the same view dimension is used for both
+        uint32_t uavIndex = descriptorHeap.Allocate();
+        uint32_t srvIndex = descriptorHeap.Allocate();
+        if (srvIndex == UINT32_MAX)
+        {
+            spdlog::error("Descriptor heap is full, can't create more textures");
+            exit(-1);
+        }
+
+        D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+        uavDesc.Format = format;
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = format;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+        if (D == 3)
+        {
+            uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE3D;
+            uavDesc.Texture3D.WSize = depth;
+            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+            srvDesc.Texture3D.MipLevels = 1;
+        }
+        else
+        {
+            uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MipLevels = 1;
+        }
+
+        this->device->CreateUnorderedAccessView(mGPUResource.Get(), nullptr, &uavDesc, descriptorHeap.GetCPUHandle(uavIndex));
+        this->device->CreateShaderResourceView(mGPUResource.Get(), &srvDesc, descriptorHeap.GetCPUHandle(srvIndex));
+
         return {
             { mGPUResource, gpuState },
             { mHostUploadResource, hostUploadState },
             { mHostReadbackResource, hostReadbackState },
-            length,
+            footprint,
+            width,
+            height,
+            depth,
             flags,
+            descriptorHeap.heap.Get(),
+            descriptorHeap.GetGPUHandle(uavIndex),
+            descriptorHeap.GetGPUHandle(srvIndex)
         };
     }
 
-    void SetShader(Shader& shader)
+    // Creates a context with its own allocator and list, to record commands on another thread
+    // The device is free-threaded, so contexts can be created from any thread
+    CommandContext CreateCommandContext()
     {
-        commandList->SetComputeRootSignature(shader.rootSignature.Get());
-        commandList->SetPipelineState(shader.pso.Get());
-    }
+        ComPtr<ID3D12CommandAllocator> contextAllocator;
+        device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&contextAllocator));
 
-    void DispatchShader(uint32_t x, uint32_t y = 1, uint32_t z = 1)
-    {
-        commandList->Dispatch(x, y, z);
+        ComPtr<ID3D12GraphicsCommandList> contextList;
+        device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, contextAllocator.Get(), nullptr, IID_PPV_ARGS(&contextList));
+
+        return { contextAllocator, contextList };
     }
 
-    bool FlushQueue()
+    // Executes the commands of this environment followed by the commands of the given contexts in a single submission
+    // The lists are executed in the order the contexts are passed, all contexts are reset for recording afterwards
+    // Before every list the buffers it uses are transitioned from the state the lists before it left them in
+    bool FlushQueue(const std::vector<CommandContext*>& contexts = {})
     {
-        commandList->Close();
+        std::vector<CommandContext*> submitted = { this };
+        submitted.insert(submitted.end(), contexts.begin(), contexts.end());
+
+        if (!transitionAllocator)
+        {
+            device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&transitionAllocator));
+        }
+        transitionAllocator->Reset();
+
+        std::vector<ID3D12CommandList*> commandLists;
+        uint32_t usedTransitionLists = 0;
+
+        for (CommandContext* context : submitted)
+        {
+            context->commandList->Close();
+
+            std::vector<D3D12_RESOURCE_BARRIER> barriers = context->ResolveBufferStates();
+            if (!barriers.empty())
+            {
+                // the lists share the allocator, which is fine as only one of them records at a time
+                if (usedTransitionLists == transitionLists.size())
+                {
+                    ComPtr<ID3D12GraphicsCommandList> transitionList;
+                    device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, transitionAllocator.Get(), nullptr, IID_PPV_ARGS(&transitionList));
+                    transitionLists.push_back(transitionList);
+                }
+                else
+                {
+                    transitionLists[usedTransitionLists]->Reset(transitionAllocator.Get(), nullptr);
+                }
+
+                ID3D12GraphicsCommandList* transitionList = transitionLists[usedTransitionLists++].Get();
+                transitionList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+                transitionList->Close();
+                commandLists.push_back(transitionList);
+            }
 
-        // Execute the list in the command queue
-        ID3D12CommandList* commandLists[] = { commandList.Get() };
-        queue->ExecuteCommandLists(_countof(commandLists), commandLists);
+            commandLists.push_back(context->commandList.Get());
+        }
+
+        // Execute the lists in the command queue
+        queue->ExecuteCommandLists((UINT)commandLists.size(), commandLists.data());
 
         // Fence to wait on the gpu to finish
         ComPtr<ID3D12Fence> fence;
@@ -543,163 +2163,110 @@ struct DX12Env
             free(message);
         }
 
-        commandList->Reset(commandAllocator.Get(), nullptr);
-
-        return success;
-    }
-
-    template<typename T>
-    ReadView<T> GetReadView(Buffer<T>& buffer)
-    {
-        T* data = nullptr;
+        Reset();
 
-        if (buffer.flags & CPURead)
+        for (CommandContext* context : contexts)
         {
-            D3D12_RANGE range = { 0, buffer.length };
-
-            buffer.hostReadbackBuffer.buffer->Map(0, &range, reinterpret_cast<void**>(&data));
+            context->Reset();
         }
 
-        return { data, buffer.length, &buffer };
+        return success;
     }
 
-    template<typename T>
-    WriteView<T> GetWriteView(Buffer<T>& buffer)
+    // Culls unused passes, computes the barriers and places the transient buffers in a single heap
+    void CompileGraph(ComputeGraph& graph)
     {
-        T* data = nullptr;
-
-        if (buffer.flags & CPUWrite)
-        {
-            D3D12_RANGE range = { 0, buffer.length };
-
-            buffer.hostUploadBuffer.buffer->Map(0, &range, reinterpret_cast<void**>(&data));
-        }
-        return { data, buffer.length, &buffer };
-    }
+        graph.compiled = graph.builder.Compile();
+        graph.transientBuffers.assign(graph.builder.resources.size(), nullptr);
+        graph.heap = nullptr;
 
-    template<typename T>
-    void SetBuffer(uint32_t index, Buffer<T>& buffer)
-    {
-        if (buffer.flags & GPUConstant)
-        {
-            this->commandList->SetComputeRootConstantBufferView(index, buffer.gpuBuffer.buffer->GetGPUVirtualAddress());
-        }
-        else
+        if (graph.compiled.heapSize > 0)
         {
-            this->commandList->SetComputeRootUnorderedAccessView(index, buffer.gpuBuffer.buffer->GetGPUVirtualAddress());
+            D3D12_HEAP_DESC heapDesc = {};
+            heapDesc.SizeInBytes = graph.compiled.heapSize;
+            heapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+            heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+            heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+            heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+            heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+
+            if (FAILED(this->device->CreateHeap(&heapDesc, IID_PPV_ARGS(&graph.heap))))
+            {
+                spdlog::error("Failed to create a heap of {} bytes for the transient buffers of the graph", graph.compiled.heapSize);
+                exit(-1);
+            }
         }
-    }
-    
-    void BufferToCopySrc(DX12Buffer& buffer)
-    {
-        if (buffer.state != D3D12_RESOURCE_STATE_COPY_SOURCE)
-        {
-            D3D12_RESOURCE_BARRIER barriers[1] = {};
-            barriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barriers[0].Transition.pResource = buffer.buffer.Get();
-            barriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-            barriers[0].Transition.StateBefore = buffer.state;
-            barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
-            this->commandList->ResourceBarrier(_countof(barriers), &barriers[0]);
 
-            buffer.state = D3D12_RESOURCE_STATE_COPY_SOURCE;
-        }
-    }
+        uint64_t transientSize = 0;
+        uint32_t culledPasses = 0;
 
-    void BufferToReadWrite(DX12Buffer& buffer)
-    {
-        if (buffer.state != D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+        for (uint32_t r = 0; r < (uint32_t)graph.builder.resources.size(); r++)
         {
-            D3D12_RESOURCE_BARRIER barriers[1] = {};
-            barriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barriers[0].Transition.pResource = buffer.buffer.Get();
-            barriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-            barriers[0].Transition.StateBefore = buffer.state;
-            barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-            this->commandList->ResourceBarrier(_countof(barriers), &barriers[0]);
-
-            buffer.state = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-        }
-    }
+            const GraphResourceDesc& resource = graph.builder.resources[r];
+            if (resource.imported || !graph.compiled.IsUsed(r))
+            {
+                continue;
+            }
 
-    void BufferToCopyDest(DX12Buffer& buffer)
-    {
-        if (buffer.state != D3D12_RESOURCE_STATE_COPY_DEST)
-        {
-            D3D12_RESOURCE_BARRIER barriers[1] = {};
-            barriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barriers[0].Transition.pResource = buffer.buffer.Get();
-            barriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-            barriers[0].Transition.StateBefore = buffer.state;
-            barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
-            this->commandList->ResourceBarrier(_countof(barriers), &barriers[0]);
+            D3D12_RESOURCE_DESC desc = {};
+            desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+            desc.Alignment = 0;
+            desc.Width = resource.size;
+            desc.Height = 1;
+            desc.DepthOrArraySize = 1;
+            desc.MipLevels = 1;
+            desc.Format = DXGI_FORMAT_UNKNOWN;
+            desc.SampleDesc.Count = 1;
+            desc.SampleDesc.Quality = 0;
+            desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+            desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+            // transient buffers are only ever used as unordered access, so they never need a transition
+            if (FAILED(this->device->CreatePlacedResource(graph.heap.Get(), graph.compiled.heapOffsets[r], &desc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&graph.transientBuffers[r]))))
+            {
+                spdlog::error("Failed to place transient buffer {} at offset {} of the graph heap", resource.name, graph.compiled.heapOffsets[r]);
+                exit(-1);
+            }
 
-            buffer.state = D3D12_RESOURCE_STATE_COPY_DEST;
+            transientSize += resource.size;
         }
-    }
 
-    void BufferToConstant(DX12Buffer& buffer)
-    {
-        if (buffer.state != D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER)
+        for (bool culled : graph.compiled.culled)
         {
-            D3D12_RESOURCE_BARRIER barriers[1] = {};
-            barriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barriers[0].Transition.pResource = buffer.buffer.Get();
-            barriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-            barriers[0].Transition.StateBefore = buffer.state;
-            barriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
-            this->commandList->ResourceBarrier(_countof(barriers), &barriers[0]);
-
-            buffer.state = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+            culledPasses += culled ? 1 : 0;
         }
+
+        spdlog::info("Compiled graph: {} of {} passes culled, {} bytes of transient buffers in a heap of {} bytes", culledPasses, graph.compiled.culled.size(), transientSize, graph.compiled.heapSize);
     }
 
-    template<typename T>
-    void UploadBuffer(Buffer<T>& buffer)
+    // maxGroups is limited to the maximum number of thread groups of a single dispatch dimension
+    template<typename TIn, typename TOut>
+    JobBatch<TIn, TOut> CreateJobBatch(uint32_t maxJobs, uint32_t maxGroups, uint32_t maxInputLength, uint32_t maxOutputLength)
     {
-        if ((buffer.flags & CPUWrite) == 0)
+        if (maxGroups > D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION)
         {
-            return; // error?
+            maxGroups = D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
         }
 
-        BufferToCopySrc(buffer.hostUploadBuffer);
-        BufferToCopyDest(buffer.gpuBuffer);
-
-        this->commandList->CopyResource(buffer.gpuBuffer.buffer.Get(), buffer.hostUploadBuffer.buffer.Get());
+        JobBatch<TIn, TOut> batch = {
+            CreateBuffer<BatchJob>(maxJobs, CPUWrite),
+            CreateBuffer<uint32_t>(maxGroups, CPUWrite),
+            CreateBuffer<TIn>(maxInputLength, CPUWrite),
+            CreateBuffer<TOut>(maxOutputLength, CPURead)
+        };
 
-        // setup for use, not necessarily will upload again
-        if (buffer.flags & GPUConstant)
-        {
-            BufferToConstant(buffer.gpuBuffer);
-        }
-        else
-        {
-            BufferToReadWrite(buffer.gpuBuffer);
-        }
+        batch.jobs.reserve(maxJobs);
+        batch.inputs.reserve(maxInputLength);
+        return batch;
     }
 
-    template<typename T>
-    void ReadbackBuffer(Buffer<T>& buffer)
+    // Only valid after the queue with the dispatch of the batch has been flushed
+    // Ends the flight of the batch, clear it only after the results are no longer used
+    template<typename TIn, typename TOut>
+    JobBatchResults<TIn, TOut> GetJobBatchResults(JobBatch<TIn, TOut>& batch)
     {
-        if ((buffer.flags & CPURead) == 0)
-        {
-            return; // error?
-        }
-
-        BufferToCopySrc(buffer.gpuBuffer);
-        BufferToCopyDest(buffer.hostReadbackBuffer);
-
-        this->commandList->CopyResource(buffer.hostReadbackBuffer.buffer.Get(), buffer.gpuBuffer.buffer.Get());
-
-        // setup for reuse, not necessarily will upload again
-        if (buffer.flags & GPUConstant)
-        {
-            BufferToConstant(buffer.gpuBuffer);
-        }
-        else
-        {
-            BufferToReadWrite(buffer.gpuBuffer);
-        }
+        batch.inFlight = false;
+        return { GetReadView(batch.outputArena), &batch };
     }
 };
 
@@ -722,4 +2289,9 @@ Shader ShaderCompilation::GetShader(DX12Env& dx12)
         rootSignature,
         pso
     };
+}
+
+void ComputeGraphResources::SetBuffer(uint32_t index, GraphBuffer buffer)
+{
+    context->commandList->SetComputeRootUnorderedAccessView(index, graph->GetResource(buffer.index)->GetGPUVirtualAddress());
 }
\ No newline at end of file
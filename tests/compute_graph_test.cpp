@@ -0,0 +1,229 @@
+#include "compute_graph.hpp"
+#include <cstdio>
+
+// Tests of the compute graph compiler, which runs without a device
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+const uint64_t Placement = 65536;
+
+static bool HasBarrier(const CompiledGraph& compiled, uint32_t step, GraphBarrierType type, uint32_t resource)
+{
+    for (const GraphBarrier& barrier : compiled.steps[step].barriers)
+    {
+        if (barrier.type == type && barrier.resource == resource)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool MemoryOverlaps(const GraphBuilder& builder, const CompiledGraph& compiled, uint32_t a, uint32_t b)
+{
+    uint64_t sizeA = (builder.resources[a].size + Placement - 1) / Placement * Placement;
+    uint64_t sizeB = (builder.resources[b].size + Placement - 1) / Placement * Placement;
+    return compiled.heapOffsets[a] < compiled.heapOffsets[b] + sizeB && compiled.heapOffsets[b] < compiled.heapOffsets[a] + sizeA;
+}
+
+static void TestCullsDeadBranch()
+{
+    GraphBuilder builder;
+    uint32_t input = builder.AddResource("input", 4096, Placement, true);
+    uint32_t temp = builder.AddResource("temp", 4096, Placement, false);
+    uint32_t dead = builder.AddResource("dead", 4096, Placement, false);
+    uint32_t output = builder.AddResource("output", 4096, Placement, true);
+
+    uint32_t first = builder.AddPass("first", { input }, { temp });
+    uint32_t unused = builder.AddPass("unused", { temp }, { dead });
+    uint32_t sideEffect = builder.AddPass("sideEffect", { temp }, { dead }, true);
+    uint32_t last = builder.AddPass("last", { temp }, { output });
+
+    CompiledGraph compiled = builder.Compile();
+
+    CHECK(!compiled.culled[first]);
+    CHECK(compiled.culled[unused]);
+    CHECK(!compiled.culled[sideEffect]);
+    CHECK(!compiled.culled[last]);
+    CHECK(compiled.steps.size() == 3);
+    CHECK(compiled.IsUsed(dead));
+}
+
+static void TestCullsWholeUnconsumedChain()
+{
+    GraphBuilder builder;
+    uint32_t input = builder.AddResource("input", 4096, Placement, true);
+    uint32_t a = builder.AddResource("a", 4096, Placement, false);
+    uint32_t b = builder.AddResource("b", 4096, Placement, false);
+
+    builder.AddPass("first", { input }, { a });
+    builder.AddPass("second", { a }, { b });
+
+    CompiledGraph compiled = builder.Compile();
+
+    CHECK(compiled.steps.empty());
+    CHECK(!compiled.IsUsed(a));
+    CHECK(!compiled.IsUsed(b));
+    CHECK(compiled.heapSize == 0);
+}
+
+static void TestSingleTransientTakesWholeBlock()
+{
+    GraphBuilder builder;
+    uint32_t temp = builder.AddResource("temp", 4096, Placement, false);
+    uint32_t output = builder.AddResource("output", 4096, Placement, true);
+
+    builder.AddPass("first", {}, { temp });
+    builder.AddPass("second", { temp }, { output });
+
+    CompiledGraph compiled = builder.Compile();
+
+    CHECK(compiled.heapSize == Placement);
+    CHECK(compiled.heapOffsets[temp] == 0);
+}
+
+static void TestChainAliasesNonOverlappingLifetimes()
+{
+    GraphBuilder builder;
+    uint32_t input = builder.AddResource("input", 4096, Placement, true);
+    uint32_t t1 = builder.AddResource("t1", 4096, Placement, false);
+    uint32_t t2 = builder.AddResource("t2", 4096, Placement, false);
+    uint32_t t3 = builder.AddResource("t3", 4096, Placement, false);
+    uint32_t output = builder.AddResource("output", 4096, Placement, true);
+
+    builder.AddPass("p0", { input }, { t1 });
+    builder.AddPass("p1", { t1 }, { t2 });
+    builder.AddPass("p2", { t2 }, { t3 });
+    builder.AddPass("p3", { t3 }, { output });
+
+    CompiledGraph compiled = builder.Compile();
+
+    // t1 and t3 are never alive at the same time, t2 overlaps both
+    CHECK(compiled.heapSize == 2 * Placement);
+    CHECK(compiled.heapOffsets[t1] % Placement == 0);
+    CHECK(compiled.heapOffsets[t2] % Placement == 0);
+    CHECK(compiled.heapOffsets[t3] % Placement == 0);
+    CHECK(compiled.heapOffsets[t1] == compiled.heapOffsets[t3]);
+    CHECK(!MemoryOverlaps(builder, compiled, t1, t2));
+    CHECK(!MemoryOverlaps(builder, compiled, t2, t3));
+
+    // first uses of aliased memory, t1 also reuses the memory of t3 from the previous execution
+    CHECK(HasBarrier(compiled, 0, GraphAliasingBarrier, t1));
+    CHECK(HasBarrier(compiled, 2, GraphAliasingBarrier, t3));
+    CHECK(!HasBarrier(compiled, 1, GraphAliasingBarrier, t2));
+
+    // writes followed by reads
+    CHECK(HasBarrier(compiled, 1, GraphUAVBarrier, t1));
+    CHECK(HasBarrier(compiled, 2, GraphUAVBarrier, t2));
+    CHECK(HasBarrier(compiled, 3, GraphUAVBarrier, t3));
+    CHECK(!HasBarrier(compiled, 0, GraphUAVBarrier, input));
+}
+
+static void TestAliveTransientsNeverShareMemory()
+{
+    GraphBuilder builder;
+    uint32_t input = builder.AddResource("input", 4096, Placement, true);
+    uint32_t output = builder.AddResource("output", 4096, Placement, true);
+
+    std::vector<uint32_t> transients;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        transients.push_back(builder.AddResource("t" + std::to_string(i), 4096 + i * 100000, Placement, false));
+    }
+
+    // every pass reads two earlier transients, so lifetimes overlap in different ways
+    builder.AddPass("p0", { input }, { transients[0], transients[1] });
+    for (uint32_t i = 2; i < 8; i++)
+    {
+        builder.AddPass("p" + std::to_string(i - 1), { transients[i - 2], transients[i - 1] }, { transients[i] });
+    }
+    builder.AddPass("last", { transients[6], transients[7] }, { output });
+
+    CompiledGraph compiled = builder.Compile();
+
+    uint64_t totalSize = 0;
+    for (uint32_t a : transients)
+    {
+        totalSize += (builder.resources[a].size + Placement - 1) / Placement * Placement;
+        CHECK(compiled.heapOffsets[a] + builder.resources[a].size <= compiled.heapSize);
+
+        for (uint32_t b : transients)
+        {
+            bool alive = compiled.firstStep[a] <= compiled.lastStep[b] && compiled.firstStep[b] <= compiled.lastStep[a];
+            if (a != b && alive)
+            {
+                CHECK(!MemoryOverlaps(builder, compiled, a, b));
+            }
+        }
+    }
+
+    CHECK(compiled.heapSize < totalSize);
+}
+
+static void TestAliasingWithSeveralEarlierOccupants()
+{
+    GraphBuilder builder;
+    uint32_t output = builder.AddResource("output", 4096, Placement, true);
+    uint32_t x = builder.AddResource("x", Placement, Placement, false);
+    uint32_t y = builder.AddResource("y", Placement, Placement, false);
+    uint32_t z = builder.AddResource("z", 2 * Placement, Placement, false);
+
+    // x and y are alive at the same time and are both replaced by z
+    builder.AddPass("p0", {}, { x, y });
+    builder.AddPass("p1", { x }, { y });
+    builder.AddPass("p2", { y }, { output });
+    builder.AddPass("p3", {}, { z });
+    builder.AddPass("p4", { z }, { output });
+
+    CompiledGraph compiled = builder.Compile();
+
+    CHECK(MemoryOverlaps(builder, compiled, z, x));
+    CHECK(MemoryOverlaps(builder, compiled, z, y));
+    CHECK(HasBarrier(compiled, 3, GraphAliasingBarrier, z));
+    CHECK(HasBarrier(compiled, 0, GraphAliasingBarrier, x));
+    CHECK(HasBarrier(compiled, 0, GraphAliasingBarrier, y));
+}
+
+static void TestReadsDontNeedBarriers()
+{
+    GraphBuilder builder;
+    uint32_t input = builder.AddResource("input", 4096, Placement, true);
+    uint32_t a = builder.AddResource("a", 4096, Placement, true);
+    uint32_t b = builder.AddResource("b", 4096, Placement, true);
+
+    builder.AddPass("p0", { input }, { a });
+    builder.AddPass("p1", { input }, { b });
+    builder.AddPass("p2", { input }, { input });
+
+    CompiledGraph compiled = builder.Compile();
+
+    CHECK(compiled.steps[0].barriers.empty());
+    CHECK(compiled.steps[1].barriers.empty());
+
+    // the write after the reads needs a barrier
+    CHECK(HasBarrier(compiled, 2, GraphUAVBarrier, input));
+    CHECK(compiled.heapSize == 0);
+}
+
+int main()
+{
+    TestCullsDeadBranch();
+    TestCullsWholeUnconsumedChain();
+    TestSingleTransientTakesWholeBlock();
+    TestChainAliasesNonOverlappingLifetimes();
+    TestAliveTransientsNeverShareMemory();
+    TestAliasingWithSeveralEarlierOccupants();
+    TestReadsDontNeedBarriers();
+
+    if (failures > 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
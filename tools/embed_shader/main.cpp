@@ -0,0 +1,273 @@
+#include <windows.h>
+#include <d3d12.h>
+#include <d3d12shader.h>
+#include <dxcapi.h>
+#include <wrl.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+
+// Writes the header of a shader compiled by precompile_shader, with the DXIL, the thread group size,
+// the bindings and the root signature taken from the compiled shader
+// Descriptor tables are written with their first range only
+//
+// embed_shader <dxil> <reflection> <output> <name> <file> <entry> <profile> [KEY=VALUE...]
+
+static bool ReadFile(const char* fileName, std::vector<char>& data)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return !data.empty();
+}
+
+static std::string Quote(const std::string& value)
+{
+	std::string quoted = "\"";
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			quoted += '\\';
+		}
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+static const char* InputTypeName(D3D_SHADER_INPUT_TYPE type)
+{
+	switch (type)
+	{
+	case D3D_SIT_CBUFFER: return "D3D_SIT_CBUFFER";
+	case D3D_SIT_TBUFFER: return "D3D_SIT_TBUFFER";
+	case D3D_SIT_TEXTURE: return "D3D_SIT_TEXTURE";
+	case D3D_SIT_SAMPLER: return "D3D_SIT_SAMPLER";
+	case D3D_SIT_UAV_RWTYPED: return "D3D_SIT_UAV_RWTYPED";
+	case D3D_SIT_STRUCTURED: return "D3D_SIT_STRUCTURED";
+	case D3D_SIT_UAV_RWSTRUCTURED: return "D3D_SIT_UAV_RWSTRUCTURED";
+	case D3D_SIT_BYTEADDRESS: return "D3D_SIT_BYTEADDRESS";
+	case D3D_SIT_UAV_RWBYTEADDRESS: return "D3D_SIT_UAV_RWBYTEADDRESS";
+	case D3D_SIT_UAV_APPEND_STRUCTURED: return "D3D_SIT_UAV_APPEND_STRUCTURED";
+	case D3D_SIT_UAV_CONSUME_STRUCTURED: return "D3D_SIT_UAV_CONSUME_STRUCTURED";
+	case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER: return "D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER";
+	default: return nullptr;
+	}
+}
+
+static const char* RootParameterTypeName(D3D12_ROOT_PARAMETER_TYPE type)
+{
+	switch (type)
+	{
+	case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE: return "D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE";
+	case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS: return "D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS";
+	case D3D12_ROOT_PARAMETER_TYPE_CBV: return "D3D12_ROOT_PARAMETER_TYPE_CBV";
+	case D3D12_ROOT_PARAMETER_TYPE_SRV: return "D3D12_ROOT_PARAMETER_TYPE_SRV";
+	case D3D12_ROOT_PARAMETER_TYPE_UAV: return "D3D12_ROOT_PARAMETER_TYPE_UAV";
+	default: return nullptr;
+	}
+}
+
+static const char* RangeTypeName(D3D12_DESCRIPTOR_RANGE_TYPE type)
+{
+	switch (type)
+	{
+	case D3D12_DESCRIPTOR_RANGE_TYPE_SRV: return "D3D12_DESCRIPTOR_RANGE_TYPE_SRV";
+	case D3D12_DESCRIPTOR_RANGE_TYPE_UAV: return "D3D12_DESCRIPTOR_RANGE_TYPE_UAV";
+	case D3D12_DESCRIPTOR_RANGE_TYPE_CBV: return "D3D12_DESCRIPTOR_RANGE_TYPE_CBV";
+	case D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER: return "D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER";
+	default: return nullptr;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 8)
+	{
+		fprintf(stderr, "usage: embed_shader <dxil> <reflection> <output> <name> <file> <entry> <profile> [KEY=VALUE...]\n");
+		return 1;
+	}
+
+	const char* dxilFile = argv[1];
+	const char* reflectionFile = argv[2];
+	const char* outputFile = argv[3];
+	std::string name = argv[4];
+
+	std::vector<char> dxil;
+	std::vector<char> reflectionData;
+	if (!ReadFile(dxilFile, dxil) || !ReadFile(reflectionFile, reflectionData))
+	{
+		fprintf(stderr, "embed_shader: can't read %s or %s\n", dxilFile, reflectionFile);
+		return 1;
+	}
+
+	ComPtr<IDxcUtils> utils;
+	ComPtr<IDxcContainerReflection> containerReflection;
+	if (FAILED(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils))) ||
+		FAILED(DxcCreateInstance(CLSID_DxcContainerReflection, IID_PPV_ARGS(&containerReflection))))
+	{
+		fprintf(stderr, "embed_shader: can't load dxcompiler.dll\n");
+		return 1;
+	}
+
+	// thread group size and bindings
+	DxcBuffer reflectionBuffer = { reflectionData.data(), reflectionData.size(), DXC_CP_ACP };
+	ComPtr<ID3D12ShaderReflection> reflection;
+	D3D12_SHADER_DESC shaderDesc = {};
+	if (FAILED(utils->CreateReflection(&reflectionBuffer, IID_PPV_ARGS(&reflection))) || FAILED(reflection->GetDesc(&shaderDesc)))
+	{
+		fprintf(stderr, "embed_shader: %s has no reflection data\n", reflectionFile);
+		return 1;
+	}
+
+	UINT threadGroupSize[3] = {};
+	reflection->GetThreadGroupSize(&threadGroupSize[0], &threadGroupSize[1], &threadGroupSize[2]);
+
+	std::vector<D3D12_SHADER_INPUT_BIND_DESC> bindings(shaderDesc.BoundResources);
+	for (UINT i = 0; i < shaderDesc.BoundResources; i++)
+	{
+		reflection->GetResourceBindingDesc(i, &bindings[i]);
+	}
+
+	// root signature, which is kept in the container next to the DXIL
+	ComPtr<IDxcBlobEncoding> dxilBlob;
+	ComPtr<IDxcBlob> rootSignaturePart;
+	UINT32 rootSignatureIndex = 0;
+	utils->CreateBlob(dxil.data(), (UINT32)dxil.size(), DXC_CP_ACP, &dxilBlob);
+	if (FAILED(containerReflection->Load(dxilBlob.Get())) ||
+		FAILED(containerReflection->FindFirstPartKind(DXC_PART_ROOT_SIGNATURE, &rootSignatureIndex)) ||
+		FAILED(containerReflection->GetPartContent(rootSignatureIndex, &rootSignaturePart)))
+	{
+		fprintf(stderr, "embed_shader: %s has no root signature, add a RootSignature attribute to the entry point\n", dxilFile);
+		return 1;
+	}
+
+	ComPtr<ID3D12VersionedRootSignatureDeserializer> deserializer;
+	const D3D12_VERSIONED_ROOT_SIGNATURE_DESC* rootSignature = nullptr;
+	if (FAILED(D3D12CreateVersionedRootSignatureDeserializer(rootSignaturePart->GetBufferPointer(), rootSignaturePart->GetBufferSize(), IID_PPV_ARGS(&deserializer))) ||
+		FAILED(deserializer->GetRootSignatureDescAtVersion(D3D_ROOT_SIGNATURE_VERSION_1_1, &rootSignature)))
+	{
+		fprintf(stderr, "embed_shader: can't read the root signature of %s\n", dxilFile);
+		return 1;
+	}
+
+	std::ostringstream header;
+	header << "#pragma once\n";
+	header << "#include \"dx12.hpp\"\n\n";
+	header << "// Generated by precompile_shader from " << argv[5] << ", do not edit\n\n";
+
+	header << "const unsigned char " << name << "_dxil[] =\n{";
+	for (size_t i = 0; i < dxil.size(); i++)
+	{
+		header << (i % 16 == 0 ? "\n    " : " ") << (uint32_t)(unsigned char)dxil[i] << ",";
+	}
+	header << "\n};\n\n";
+
+	uint32_t defineCount = (uint32_t)(argc - 8);
+	if (defineCount > 0)
+	{
+		header << "const ShaderDefine " << name << "_defines[] =\n{\n";
+		for (int i = 8; i < argc; i++)
+		{
+			std::string define = argv[i];
+			size_t separator = define.find('=');
+			std::string key = define.substr(0, separator);
+			std::string value = separator == std::string::npos ? "1" : define.substr(separator + 1);
+			header << "    { " << Quote(key) << ", " << Quote(value) << " },\n";
+		}
+		header << "};\n\n";
+	}
+
+	if (!bindings.empty())
+	{
+		header << "const ShaderBinding " << name << "_bindings[] =\n{\n";
+		for (const D3D12_SHADER_INPUT_BIND_DESC& binding : bindings)
+		{
+			const char* typeName = InputTypeName(binding.Type);
+			std::string type = typeName ? typeName : "(D3D_SHADER_INPUT_TYPE)" + std::to_string(binding.Type);
+			header << "    { " << Quote(binding.Name) << ", " << type << ", " << binding.BindPoint << ", " << binding.Space << ", " << binding.BindCount << " },\n";
+		}
+		header << "};\n\n";
+	}
+
+	const D3D12_ROOT_SIGNATURE_DESC1& rootSignatureDesc = rootSignature->Desc_1_1;
+	if (rootSignatureDesc.NumParameters > 0)
+	{
+		header << "const ShaderRootParameter " << name << "_rootParameters[] =\n{\n";
+		for (UINT i = 0; i < rootSignatureDesc.NumParameters; i++)
+		{
+			const D3D12_ROOT_PARAMETER1& parameter = rootSignatureDesc.pParameters[i];
+
+			uint32_t shaderRegister = 0;
+			uint32_t registerSpace = 0;
+			uint32_t num32BitValues = 0;
+			D3D12_DESCRIPTOR_RANGE_TYPE rangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+			uint32_t numDescriptors = 1;
+			switch (parameter.ParameterType)
+			{
+			case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+				if (parameter.DescriptorTable.NumDescriptorRanges > 0)
+				{
+					shaderRegister = parameter.DescriptorTable.pDescriptorRanges[0].BaseShaderRegister;
+					registerSpace = parameter.DescriptorTable.pDescriptorRanges[0].RegisterSpace;
+					rangeType = parameter.DescriptorTable.pDescriptorRanges[0].RangeType;
+					numDescriptors = parameter.DescriptorTable.pDescriptorRanges[0].NumDescriptors;
+				}
+				break;
+			case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+				shaderRegister = parameter.Constants.ShaderRegister;
+				registerSpace = parameter.Constants.RegisterSpace;
+				num32BitValues = parameter.Constants.Num32BitValues;
+				numDescriptors = 0;
+				break;
+			default:
+				shaderRegister = parameter.Descriptor.ShaderRegister;
+				registerSpace = parameter.Descriptor.RegisterSpace;
+				break;
+			}
+
+			const char* typeName = RootParameterTypeName(parameter.ParameterType);
+			std::string type = typeName ? typeName : "(D3D12_ROOT_PARAMETER_TYPE)" + std::to_string(parameter.ParameterType);
+			const char* rangeTypeName = RangeTypeName(rangeType);
+			std::string range = rangeTypeName ? rangeTypeName : "(D3D12_DESCRIPTOR_RANGE_TYPE)" + std::to_string(rangeType);
+			header << "    { " << type << ", " << shaderRegister << ", " << registerSpace << ", " << num32BitValues << ", " << range << ", " << numDescriptors << " },\n";
+		}
+		header << "};\n\n";
+	}
+
+	// arrays can't be empty, so missing tables are null
+	header << "const PrecompiledShader " << name << " =\n{\n";
+	header << "    " << Quote(name) << ",\n";
+	header << "    " << Quote(argv[5]) << ",\n";
+	header << "    " << Quote(argv[6]) << ",\n";
+	header << "    " << Quote(argv[7]) << ",\n";
+	header << "    " << (defineCount > 0 ? name + "_defines" : "nullptr") << ",\n";
+	header << "    " << defineCount << ",\n";
+	header << "    " << name << "_dxil,\n";
+	header << "    sizeof(" << name << "_dxil),\n";
+	header << "    { " << threadGroupSize[0] << ", " << threadGroupSize[1] << ", " << threadGroupSize[2] << " },\n";
+	header << "    " << (!bindings.empty() ? name + "_bindings" : "nullptr") << ",\n";
+	header << "    " << bindings.size() << ",\n";
+	header << "    " << (rootSignatureDesc.NumParameters > 0 ? name + "_rootParameters" : "nullptr") << ",\n";
+	header << "    " << rootSignatureDesc.NumParameters << "\n";
+	header << "};\n";
+
+	std::ofstream output(outputFile, std::ios::binary);
+	output << header.str();
+	if (!output)
+	{
+		fprintf(stderr, "embed_shader: can't write %s\n", outputFile);
+		return 1;
+	}
+
+	return 0;
+}